@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+##
+## bench.py
+## Benchmark driver: compiles each benchmark of a suite in several variants and reports static
+## instruction counts, executed instruction counts (pigsvm.py) and wall-clock times (pigpiod) as JSON.
+##
+
+import sys, io, argparse, configparser, json, statistics
+from time import time, sleep
+from pathlib import Path, PurePath
+
+sys.path.append(str(Path(__file__).resolve().parent.parent))
+from pcc import pcc
+import pigsvm
+
+VARIANTS = {                                ## dict(str name: dict pcc options), compiled variants
+    'cis':   {'use_cis': True,  'do_reduce': True},
+    'cis-n': {'use_cis': True,  'do_reduce': False},
+    'eis':   {'use_cis': False, 'do_reduce': True},
+    'eis-n': {'use_cis': False, 'do_reduce': False},
+}
+
+def parse_parameter(p_str):
+    if p_str is None:
+        return None
+    return [int(p, 0) for p in p_str.strip('[]').split(',') if p.strip()]
+
+## ---------------------------------------------------------------------------
+
+class BenchHal(pigsvm.PigsHal):
+    ## deterministic workload inputs: input GPIOs read pseudo-random levels that change every
+    ## INPUT_STEP_US of emulated time, each read takes READ_US, an I2C device always answers
+    ## with a temperature word (TMP102 format) around 25 degree Celsius
+    INPUT_STEP_US = 50                      ## emulated time between input level changes
+    READ_US = 1                             ## emulated time of a GPIO read
+
+    def __init__(self, seed=0xace1):
+        super().__init__()
+        self.seed = seed                    ## int, LFSR state at time 0
+        self.lfsr = seed                    ## int, 16 bit Galois LFSR, current input pattern
+        self.lfsr_tick_us = 0               ## int, emulated time of the current input pattern
+
+    def _instr_READ(self, gpio):
+        if 0 <= gpio < self.GPIO_COUNT and self.modes[gpio] == 0:
+            return (self._inputs() >> (gpio % 16)) & 1
+        return super()._instr_READ(gpio)
+
+    def _instr_BR1(self):
+        inputs = self._inputs()
+        bits = super()._instr_BR1()
+        for gpio in range(32):
+            if self.modes[gpio] == 0:
+                bits = (bits & ~(1 << gpio)) | (((inputs >> (gpio % 16)) & 1) << gpio)
+        return bits
+
+    def _instr_I2CO(self, bus, addr, flags):
+        return 0
+
+    def _instr_I2CRW(self, handle, reg):
+        raw = 400 + (self._step_lfsr() & 0x1f)  ## 12 bit, 0.0625 C/LSB
+        return (raw >> 4) | ((raw & 0x0f) << 12)
+
+    ## Private functions
+
+    def _inputs(self):
+        self.advance(self.READ_US)
+        while self.lfsr_tick_us + self.INPUT_STEP_US <= self.tick_us:
+            self.lfsr_tick_us += self.INPUT_STEP_US
+            self._step_lfsr()
+        return self.lfsr
+
+    def _step_lfsr(self):
+        self.lfsr = (self.lfsr >> 1) ^ (0xb400 if self.lfsr & 1 else 0)
+        return self.lfsr
+
+## ---------------------------------------------------------------------------
+
+class BenchRunner:
+    def __init__(self, variants, max_steps=None, pi=None, repeat=3, timeout_sec=60):
+        self.variants = variants            ## list(str), names of VARIANTS to compile
+        self.max_steps = max_steps          ## None or int, emulator step limit per run
+        self.pi = pi                        ## None or pigpio.pi, pigpiod for wall-clock times
+        self.repeat = repeat                ## int, number of timed pigpiod runs (best and median are reported)
+        self.timeout_sec = timeout_sec      ## float, pigpiod run timeout
+
+    def run_suite(self, conf_filename):
+        ## returns dict, JSON report of all benchmarks in conf_filename
+        config = configparser.ConfigParser()
+        if not config.read(conf_filename):
+            raise OSError(f'cannot read "{conf_filename}"')
+        benchmarks = []
+        for section_name in config.sections():
+            section = config[section_name]
+            c_filepath = str(Path(conf_filename).with_name(section['c_file']))
+            benchmarks.append(self.run_benchmark(section_name, c_filepath,
+                parse_parameter(section.get('param_in')), parse_parameter(section.get('param_out'))))
+        totals = {variant: {'static_instrs': 0, 'executed_instrs': 0} for variant in self.variants}
+        for benchmark in benchmarks:
+            for variant, result in benchmark['variants'].items():
+                for key in totals[variant]:
+                    totals[variant][key] += result.get(key) or 0
+        return {'suite': PurePath(conf_filename).name, 'variants': {variant: VARIANTS[variant]
+            for variant in self.variants}, 'benchmarks': benchmarks, 'totals': totals}
+
+    def run_benchmark(self, name, c_filepath, param_in, param_out):
+        results = {}
+        for variant in self.variants:
+            log = io.StringIO()
+            cc_result = pcc([c_filepath], log_file=log, **VARIANTS[variant])
+            if cc_result is None:
+                results[variant] = {'ok': False, 'error': log.getvalue().strip()}
+                continue
+            result = {'ok': True, 'static_instrs': self.static_instr_count(cc_result.asm_code),
+                'tags': cc_result.tag_count, 'vars': cc_result.var_count}
+            result.update(self.emulate(cc_result.asm_code, param_in, param_out))
+            if self.pi is not None:
+                result.update(self.time_on_pigpiod(cc_result.asm_code, param_in))
+            results[variant] = result
+        return {'name': name, 'c_file': PurePath(c_filepath).name, 'param_in': param_in, 'variants': results}
+
+    @staticmethod
+    def static_instr_count(asm_code):
+        return sum(1 for line in asm_code.splitlines()
+            if line.split(';')[0].strip() and not line.split()[0].upper() == 'TAG')
+
+    def emulate(self, asm_code, param_in, param_out):
+        hal = BenchHal()
+        try:
+            vm = pigsvm.PigsVm(pigsvm.PigsProgram(asm_code), hal, self.max_steps)
+            vm.run(param_in)
+        except pigsvm.PigsError as e:
+            return {'ok': False, 'error': f'emulator: {e}', 'executed_instrs': None}
+        result = {'executed_instrs': vm.step_count, 'emulated_us': hal.tick_us, 'param_out': vm.p}
+        if param_out is not None and vm.p[:len(param_out)] != param_out:
+            result.update(ok=False, error=f'unexpected output parameter {vm.p}')
+        return result
+
+    def time_on_pigpiod(self, asm_code, param_in):
+        ## returns dict, best and median wall-clock seconds from run_script() until the script halted,
+        ## including the status poll latency (about 1 ms)
+        import pigpio
+        sid = self.pi.store_script(asm_code.encode('utf-8'))
+        try:
+            wall_secs = []
+            for i_run in range(self.repeat):
+                t_start = time()
+                self.pi.run_script(sid, param_in)
+                while self.pi.script_status(sid)[0] != pigpio.PI_SCRIPT_HALTED:
+                    if time() - t_start > self.timeout_sec:
+                        self.pi.stop_script(sid)
+                        return {'ok': False, 'error': 'pigpiod: script timed out', 'wall_sec': None}
+                    sleep(0.001)
+                wall_secs.append(time() - t_start)
+        finally:
+            self.pi.delete_script(sid)
+        return {'wall_sec': min(wall_secs), 'wall_sec_median': statistics.median(wall_secs)}
+
+## ---------------------------------------------------------------------------
+
+def format_table(report, baseline=None):
+    ## returns str, executed instructions per benchmark and variant, with relative change to baseline report
+    base = {}
+    if baseline is not None:
+        for benchmark in baseline.get('benchmarks', []):
+            for variant, result in benchmark['variants'].items():
+                base[benchmark['name'], variant] = result
+    variants = list(report['variants'])
+    lines = [f'{"benchmark":<20}' + ''.join(f' {variant + " static":>13} {variant + " exec":>17}' for variant in variants)]
+    for benchmark in report['benchmarks']:
+        line = f'{benchmark["name"]:<20}'
+        for variant in variants:
+            result = benchmark['variants'].get(variant, {})
+            line += ''.join(f' {format_count(result.get(key), base.get((benchmark["name"], variant), {}).get(key), width)}'
+                for key, width in (('static_instrs', 13), ('executed_instrs', 17)))
+            if not result.get('ok'):
+                line += ' !'
+        lines.append(line)
+    return '\n'.join(lines)
+
+def format_count(count, base_count, width):
+    if count is None:
+        return f'{"-":>{width}}'
+    if not base_count:
+        return f'{count:>{width}}'
+    return f'{f"{count} ({(count - base_count) * 100 / base_count:+.1f}%)":>{width}}'
+
+def main():
+    parser = argparse.ArgumentParser(description='bench - PIGS C compiler benchmark driver')
+    parser.add_argument('conf', metavar='FILE', nargs='?', default=str(Path(__file__).with_name('bench.conf')),
+        help='benchmark suite (default: bench.conf)')
+    parser.add_argument('-o', dest='output', metavar='FILE', default='-', help='JSON report file (default: STDOUT)')
+    parser.add_argument('-c', dest='baseline', metavar='FILE', help='compare executed instructions with JSON report FILE')
+    parser.add_argument('-V', dest='variants', metavar='VARIANT', action='append', choices=list(VARIANTS),
+        help=f'compile variant (repeatable, default: all of {", ".join(VARIANTS)})')
+    parser.add_argument('-m', dest='max_steps', metavar='N', type=int, default=10_000_000,
+        help='emulator limit of executed instructions per run (default: 10000000)')
+    parser.add_argument('-i', dest='hostname', metavar='HOSTNAME', help='also measure wall-clock times on pigpiod HOSTNAME')
+    parser.add_argument('-p', dest='port', metavar='PORT', type=int, default=8888, help='port number of pigpiod (default: 8888)')
+    parser.add_argument('-r', dest='repeat', metavar='N', type=int, default=3, help='number of timed runs on pigpiod (default: 3)')
+    args = parser.parse_args()
+
+    pi = None
+    if args.hostname is not None:
+        import pigpio
+        pi = pigpio.pi(args.hostname, args.port)
+        if not pi.connected:
+            print(f'*** error: failed to connect pigpiod on "{args.hostname}"', file=sys.stderr)
+            return 1
+    try:
+        baseline = None
+        if args.baseline is not None:
+            with open(args.baseline, 'r') as f:
+                baseline = json.load(f)
+        runner = BenchRunner(args.variants or list(VARIANTS), args.max_steps, pi, args.repeat)
+        report = runner.run_suite(args.conf)
+        report_json = json.dumps(report, indent=2)
+        if args.output == '-':
+            print(report_json)
+        else:
+            with open(args.output, 'w') as f:
+                f.write(report_json + '\n')
+    except (OSError, ValueError, KeyError) as e:
+        print(f'*** error: {e}', file=sys.stderr)
+        return 1
+    finally:
+        if pi is not None:
+            pi.stop()
+    print(format_table(report, baseline), file=sys.stderr)
+    failed = [benchmark['name'] for benchmark in report['benchmarks']
+        if not all(result.get('ok') for result in benchmark['variants'].values())]
+    if failed:
+        print(f'*** failed: {", ".join(failed)}', file=sys.stderr)
+        return 1
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
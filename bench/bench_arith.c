@@ -0,0 +1,61 @@
+// bench_arith.c
+// Busy arithmetic loop: xorshift32 random numbers, integer square roots and GCDs
+// p0: number of iterations
+// returns p0: XOR of all square roots, p1: sum of all GCDs, p2: final random state
+
+int rng_state = 314159265;
+
+int xorshift32(void)
+{
+    int x = rng_state;
+    x ^= x << 13;
+    x ^= (x >> 17) & 0x7fff;    // logical shift right of a signed int
+    x ^= x << 5;
+    rng_state = x;
+    return x;
+}
+
+int isqrt(int n)
+{
+    int root = 0, bit = 1 << 30;
+    while (bit > n) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+int gcd(int a, int b)
+{
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+void main(void)
+{
+    int iterations = p0, i;
+    int sqrt_xor = 0, gcd_sum = 0;
+
+    for (i = 0; i < iterations; i++) {
+        int a = xorshift32() & 0x7fffffff;
+        int b = (xorshift32() & 0xffff) + 1;
+        sqrt_xor ^= isqrt(a);
+        gcd_sum += gcd(a, b);
+    }
+    p0 = sqrt_xor;
+    p1 = gcd_sum;
+    p2 = rng_state;
+}
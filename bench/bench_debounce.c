@@ -0,0 +1,62 @@
+// bench_debounce.c
+// Button debounce: samples a bouncing input with an integrating debouncer
+// p0: number of samples, p1: sample interval in microseconds
+// returns p0: number of debounced presses, p1: number of debounced releases, p2: raw level changes
+
+enum {
+    PIN_BUTTON  = 23,
+    INTEGRATOR_MAX = 4,
+};
+
+int integrator = 0;
+int state = 0;
+
+int debounce(int level)
+{
+    if (level == 0) {
+        if (integrator > 0) {
+            integrator--;
+        }
+    }
+    else if (integrator < INTEGRATOR_MAX) {
+        integrator++;
+    }
+    if (integrator == 0) {
+        state = 0;
+    }
+    else if (integrator >= INTEGRATOR_MAX) {
+        state = 1;
+    }
+    return state;
+}
+
+void main(void)
+{
+    int samples = p0, interval_us = p1;
+    int presses = 0, releases = 0, changes = 0;
+    int last_level = 0, last_state = 0, i;
+
+    gpioSetMode(PIN_BUTTON, PI_INPUT);
+    gpioSetPullUpDown(PIN_BUTTON, PI_PUD_DOWN);
+    for (i = 0; i < samples; i++) {
+        int level = gpioRead(PIN_BUTTON);
+        int new_state = debounce(level);
+        if (level != last_level) {
+            changes++;
+            last_level = level;
+        }
+        if (new_state != last_state) {
+            if (new_state) {
+                presses++;
+            }
+            else {
+                releases++;
+            }
+            last_state = new_state;
+        }
+        gpioDelay_us(interval_us);
+    }
+    p0 = presses;
+    p1 = releases;
+    p2 = changes;
+}
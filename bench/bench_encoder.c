@@ -0,0 +1,49 @@
+// bench_encoder.c
+// Rotary encoder: decodes quadrature signals A/B sampled from bank 1
+// p0: number of samples
+// returns p0: position, p1: number of valid steps, p2: number of invalid transitions
+
+enum {
+    PIN_A = 17,
+    PIN_B = 27,
+};
+
+int position = 0;
+int steps = 0;
+int invalid = 0;
+
+void decode(int prev, int cur)
+{
+    int transition = (prev << 2) | cur;
+    if (prev == cur) {
+        return;
+    }
+    if (transition == 1 || transition == 7 || transition == 14 || transition == 8) {
+        position++;
+        steps++;
+    }
+    else if (transition == 2 || transition == 11 || transition == 13 || transition == 4) {
+        position--;
+        steps++;
+    }
+    else {
+        invalid++;
+    }
+}
+
+void main(void)
+{
+    int samples = p0, prev = 0, i;
+
+    gpioSetMode(PIN_A, PI_INPUT);
+    gpioSetMode(PIN_B, PI_INPUT);
+    for (i = 0; i < samples; i++) {
+        int bits = gpioRead_Bits_0_31();
+        int cur = (((bits >> PIN_A) & 1) << 1) | ((bits >> PIN_B) & 1);
+        decode(prev, cur);
+        prev = cur;
+    }
+    p0 = position;
+    p1 = steps;
+    p2 = invalid;
+}
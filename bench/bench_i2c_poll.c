@@ -0,0 +1,58 @@
+// bench_i2c_poll.c
+// I2C sensor polling: reads the temperature register of a TMP102 and tracks min/max/mean
+// p0: number of readings, p1: poll interval in milliseconds
+// returns p0: minimum, p1: maximum, p2: mean (in 1/100 degree Celsius), p3: failed reads
+
+enum {
+    I2C_BUS      = 1,
+    TMP102_ADDR  = 0x48,
+    TMP102_TEMP  = 0x00,
+};
+
+int to_centi_celsius(int word)
+{
+    // SMBus word is little endian, TMP102 sends MSB first: 12 bit two's complement, 0.0625 C/LSB
+    int raw = ((word & 0xff) << 4) | ((word >> 12) & 0x0f);
+    if (raw & 0x800) {
+        raw -= 0x1000;
+    }
+    return raw * 625 / 100;
+}
+
+void main(void)
+{
+    int readings = p0, interval_ms = p1, i;
+    int t_min = 32767, t_max = -32768, t_sum = 0, count = 0, failed = 0;
+    int handle = i2cOpen(I2C_BUS, TMP102_ADDR, 0);
+
+    if (handle < 0) {
+        p3 = handle;
+        return;
+    }
+    for (i = 0; i < readings; i++) {
+        int word = i2cReadWordData(handle, TMP102_TEMP);
+        if (word < 0) {
+            failed++;
+        }
+        else {
+            int t = to_centi_celsius(word);
+            if (t < t_min) {
+                t_min = t;
+            }
+            if (t > t_max) {
+                t_max = t;
+            }
+            t_sum += t;
+            count++;
+        }
+        gpioDelay_ms(interval_ms);
+    }
+    i2cClose(handle);
+    p0 = t_min;
+    p1 = t_max;
+    p2 = 0;
+    if (count > 0) {
+        p2 = t_sum / count;
+    }
+    p3 = failed;
+}
@@ -0,0 +1,75 @@
+// bench_onewire.c
+// Bit-banged 1-wire: reset/presence pulse, then reads 8-byte ROM codes and checks their CRC-8
+// p0: number of ROM code reads
+// returns p0: number of reads with presence pulse, p1: number of CRC matches, p2: XOR of all CRCs
+
+enum {
+    PIN_DQ = 4,
+    CRC8_POLY = 0x8c,   // x^8 + x^5 + x^4 + 1, reflected
+};
+
+int ow_reset(void)
+{
+    int presence;
+    gpioSetMode(PIN_DQ, PI_OUTPUT);
+    gpioWrite(PIN_DQ, 0);
+    gpioDelay_us(480);
+    gpioSetMode(PIN_DQ, PI_INPUT);
+    gpioDelay_us(70);
+    presence = !gpioRead(PIN_DQ);
+    gpioDelay_us(410);
+    return presence;
+}
+
+int ow_read_byte(void)
+{
+    int value = 0, bit;
+    for (bit = 0; bit < 8; bit++) {
+        gpioSetMode(PIN_DQ, PI_OUTPUT);
+        gpioWrite(PIN_DQ, 0);
+        gpioDelay_us(2);
+        gpioSetMode(PIN_DQ, PI_INPUT);
+        gpioDelay_us(10);
+        value |= gpioRead(PIN_DQ) << bit;
+        gpioDelay_us(50);
+    }
+    return value;
+}
+
+int crc8_update(int crc, int value)
+{
+    int bit;
+    for (bit = 0; bit < 8; bit++) {
+        int mix = (crc ^ value) & 1;
+        crc >>= 1;
+        if (mix) {
+            crc ^= CRC8_POLY;
+        }
+        value >>= 1;
+    }
+    return crc;
+}
+
+void main(void)
+{
+    int reads = p0, i, j;
+    int presences = 0, matches = 0, crc_xor = 0;
+
+    gpioSetPullUpDown(PIN_DQ, PI_PUD_UP);
+    for (i = 0; i < reads; i++) {
+        int crc = 0;
+        if (ow_reset()) {
+            presences++;
+        }
+        for (j = 0; j < 7; j++) {
+            crc = crc8_update(crc, ow_read_byte());
+        }
+        if (ow_read_byte() == crc) {
+            matches++;
+        }
+        crc_xor ^= crc;
+    }
+    p0 = presences;
+    p1 = matches;
+    p2 = crc_xor;
+}
@@ -0,0 +1,36 @@
+// bench_pwm.c
+// Software PWM: ramps the duty cycle of an LED pin up and down with busy-wait delays
+// p0: number of PWM periods, p1: period in microseconds
+// returns p0: total high time in microseconds, p1: number of duty cycle reversals
+
+enum {
+    PIN_LED   = 18,
+    DUTY_STEP = 5,
+};
+
+void main(void)
+{
+    int periods = p0, period_us = p1;
+    int duty = 0, step = DUTY_STEP, i;
+    int high_us = 0, reversals = 0;
+
+    gpioSetMode(PIN_LED, PI_OUTPUT);
+    for (i = 0; i < periods; i++) {
+        int on_us = period_us * duty / 100;
+        if (on_us > 0) {
+            gpioWrite(PIN_LED, 1);
+            gpioDelay_us(on_us);
+            high_us += on_us;
+        }
+        gpioWrite(PIN_LED, 0);
+        gpioDelay_us(period_us - on_us);
+
+        duty += step;
+        if (duty >= 100 || duty <= 0) {
+            step = -step;
+            reversals++;
+        }
+    }
+    p0 = high_us;
+    p1 = reversals;
+}
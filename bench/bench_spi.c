@@ -0,0 +1,51 @@
+// bench_spi.c
+// Bit-banged SPI (mode 0, MSB first): clocks bytes out on MOSI and in from MISO
+// p0: number of bytes to transfer
+// returns p0: XOR of all received bytes, p1: sum of all received bytes
+
+enum {
+    PIN_SCLK = 11,
+    PIN_MOSI = 10,
+    PIN_MISO = 9,
+    PIN_CS   = 8,
+    MASK_SCLK = 1 << PIN_SCLK,
+    MASK_MOSI = 1 << PIN_MOSI,
+    MASK_CS   = 1 << PIN_CS,
+};
+
+int spi_transfer(int tx)
+{
+    int rx = 0, bit;
+    for (bit = 7; bit >= 0; bit--) {
+        if ((tx >> bit) & 1) {
+            gpioWrite_Bits_0_31_Set(MASK_MOSI);
+        }
+        else {
+            gpioWrite_Bits_0_31_Clear(MASK_MOSI);
+        }
+        gpioWrite_Bits_0_31_Set(MASK_SCLK);
+        rx = (rx << 1) | gpioRead(PIN_MISO);
+        gpioWrite_Bits_0_31_Clear(MASK_SCLK);
+    }
+    return rx;
+}
+
+void main(void)
+{
+    int count = p0, i;
+    int rx_xor = 0, rx_sum = 0;
+
+    gpioSetMode(PIN_SCLK, PI_OUTPUT);
+    gpioSetMode(PIN_MOSI, PI_OUTPUT);
+    gpioSetMode(PIN_CS, PI_OUTPUT);
+    gpioSetMode(PIN_MISO, PI_INPUT);
+    gpioWrite_Bits_0_31_Clear(MASK_SCLK | MASK_CS);
+    for (i = 0; i < count; i++) {
+        int rx = spi_transfer((i * 37 + 11) & 0xff);
+        rx_xor ^= rx;
+        rx_sum += rx;
+    }
+    gpioWrite_Bits_0_31_Set(MASK_CS);
+    p0 = rx_xor;
+    p1 = rx_sum;
+}
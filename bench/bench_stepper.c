@@ -0,0 +1,61 @@
+// bench_stepper.c
+// Stepper motor: drives the four coils of a unipolar stepper in full steps, back and forth
+// p0: number of steps, p1: step delay in microseconds
+// returns p0: final position, p1: levels of the coil pins (GPIO bank 1 bits), p2: number of reversals
+
+enum {
+    PIN_COIL_A = 5,
+    PIN_COIL_B = 6,
+    PIN_COIL_C = 13,
+    PIN_COIL_D = 19,
+    COIL_MASK  = (1 << PIN_COIL_A) | (1 << PIN_COIL_B) | (1 << PIN_COIL_C) | (1 << PIN_COIL_D),
+    TRAVEL     = 48,    // steps between reversals
+};
+
+void main(void)
+{
+    int steps = p0, delay_us = p1;
+    int position = 0, direction = 1, travel = 0, reversals = 0, i;
+
+    gpioSetMode(PIN_COIL_A, PI_OUTPUT);
+    gpioSetMode(PIN_COIL_B, PI_OUTPUT);
+    gpioSetMode(PIN_COIL_C, PI_OUTPUT);
+    gpioSetMode(PIN_COIL_D, PI_OUTPUT);
+    for (i = 0; i < steps; i++) {
+        switch (position & 3) {
+        case 0:
+            gpioWrite(PIN_COIL_A, 1);
+            gpioWrite(PIN_COIL_B, 0);
+            gpioWrite(PIN_COIL_C, 0);
+            gpioWrite(PIN_COIL_D, 1);
+            break;
+        case 1:
+            gpioWrite(PIN_COIL_A, 1);
+            gpioWrite(PIN_COIL_B, 1);
+            gpioWrite(PIN_COIL_C, 0);
+            gpioWrite(PIN_COIL_D, 0);
+            break;
+        case 2:
+            gpioWrite(PIN_COIL_A, 0);
+            gpioWrite(PIN_COIL_B, 1);
+            gpioWrite(PIN_COIL_C, 1);
+            gpioWrite(PIN_COIL_D, 0);
+            break;
+        default:
+            gpioWrite(PIN_COIL_A, 0);
+            gpioWrite(PIN_COIL_B, 0);
+            gpioWrite(PIN_COIL_C, 1);
+            gpioWrite(PIN_COIL_D, 1);
+        }
+        gpioDelay_us(delay_us);
+        position += direction;
+        if (++travel == TRAVEL) {
+            travel = 0;
+            direction = -direction;
+            reversals++;
+        }
+    }
+    p0 = position;
+    p1 = gpioRead_Bits_0_31() & COIL_MASK;
+    p2 = reversals;
+}
@@ -4,16 +4,33 @@
 ## PIGS C compiler
 ##
 
-import sys, argparse, re, collections
+import sys, os, io, argparse, re, collections, configparser, hashlib, pickle, json, traceback, multiprocessing, copy
+import time, contextlib
 from pathlib import PurePath, Path
 
 from pycparser import c_ast
 from pycparser.c_parser import CParser
+from pycparser.c_generator import CGenerator
 from pycparser.plyparser import ParseError
 
 SCR0     = 'v0'                             ## General purpose (scratch) register
 ARG_REGS = ('v1', 'v2', 'v3')               ## Function argument register (ARG0 ... ARG2)
 
+VM_MAX_VARS = 150                           ## Number of VM variables
+VM_MAX_TAGS = 50                            ## Number of VM tags
+INLINE_MAX_STMT_COUNT = 1000                ## Script size (in statements) the in-line expansions may grow to
+INLINE_MAX_FUNC_SIZE = 8                    ## Body size (in statements) of user-defined functions expanded in-line
+SWITCH_TREE_MIN_CASES = 4                   ## Number of case values from which a switch dispatches by binary search
+SWITCH_TREE_MAX_TAGS = 8                    ## Number of tags a switch's binary search may use
+LOOP_MAX_INVARIANTS = 4                     ## Number of invariant expressions hoisted in front of one loop
+UNROLL_MAX_TRIP_COUNT = 64                  ## Number of iterations of a for loop that may be unrolled
+UNROLL_MAX_STMT_GROWTH = 64                 ## Script size (in statements) unrolling a loop may add at -O2
+UNROLL_MAX_TAG_GROWTH = 4                   ## Number of tags unrolling a loop may add at -O2
+EVAL_MAX_STEPS = 10000                      ## Number of statements and expressions a compile-time evaluated call may take
+EVAL_MAX_CALL_DEPTH = 16                    ## Nesting depth of calls in a compile-time evaluated call
+PROFILE_HOT_COUNT = 100                     ## Number of profiled executions from which a function or loop counts as hot
+PROFILE_DUMP_MARK = 0x50524f00              ## p9 value (plus chunk number) announcing profile counters in p0 ... p8
+
 class PccError(Exception):
     def __init__(self, node, message):
         super().__init__(message)
@@ -51,6 +68,7 @@ class AsmTag(AsmStatement):
         super().__init__()
         self.vm_tag_id = None               ## None (unbound) or str "1", "2", ..., any unique positive integer
         self.unbound_id = None              ## str, fallback-id for unbound TAG labels
+        self.alias = None                   ## None or AsmTag, tag this (dropped) tag was merged into
 
     def format_statement(self):
         return f'TAG {self}'
@@ -58,6 +76,23 @@ class AsmTag(AsmStatement):
     def bind(self, vm_tag_id):
         self.vm_tag_id = str(vm_tag_id)
 
+    def resolve(self):
+        ## returns AsmTag, the tag all merged tags of this tag's set are represented by, shortens
+        ## the alias chain on the way (union-find)
+        root = self
+        while root.alias is not None:
+            root = root.alias
+        asm_tag = self
+        while asm_tag.alias is not None and asm_tag.alias is not root:
+            asm_tag.alias, asm_tag = root, asm_tag.alias
+        return root
+
+    def merge_into(self, asm_tag):
+        ## merge this tag into asm_tag, uses of this tag resolve to asm_tag from now on
+        root = asm_tag.resolve()
+        if root is not self:
+            self.alias = root
+
     _unbound_counter = 0
     def __str__(self):
         if self.vm_tag_id is not None:
@@ -72,10 +107,34 @@ class AsmCmd(AsmStatement):
         super().__init__(comment=comment)
         self.instr = instr                  ## str, uppercase assembly language instruction
         self.args = args                    ## list(arg), command's arguments of type int, str, AsmVar or AsmTag
+        self.coord = None                   ## None or c_ast Coord, position of the C statement compiled into the command
 
     def format_statement(self):
         return f'    {self.instr: <5} {" ".join([str(arg) for arg in self.args])}'
 
+    VAR_WRITE_INSTR = ('STA', 'POP')                ## instructions that only write their variable argument
+    VAR_UPDATE_INSTR = ('INR', 'DCR', 'XA', 'X')    ## instructions that read and write their variable argument(s)
+
+    def var_access(self):
+        ## returns tuple(list(AsmVar) read_vars, list(AsmVar) written_vars), variable arguments
+        ## of any other instruction (including unknown ones from asm()) are treated as read-only
+        if self.instr == 'LD':
+            read_args, written_args = self.args[1:], self.args[:1]
+        elif self.instr in self.VAR_WRITE_INSTR:
+            read_args, written_args = [], self.args
+        elif self.instr in self.VAR_UPDATE_INSTR:
+            read_args, written_args = self.args, self.args
+        else:
+            read_args, written_args = self.args, []
+        return [arg for arg in read_args if isinstance(arg, AsmVar)], \
+            [arg for arg in written_args if isinstance(arg, AsmVar)]
+
+    ## instructions that set F := A
+    F_EQ_A_INSTR = ('ADD', 'SUB', 'MLT', 'DIV', 'MOD', 'AND', 'OR', 'XOR', 'RLA', 'RRA',
+        'LDAF', 'NOTL', 'ANDL', 'ORL', 'EQ', 'NE', 'GT', 'GE', 'LT', 'LE', 'NEG', 'NOT', 'MI', 'PUDI')
+    ## instructions that modify neither A nor F
+    AF_KEEP_INSTR = ('STA', 'LD', 'POP', 'PUSH', 'PUSHA', 'JMP', 'JNZ', 'JZ', 'JP', 'JM')
+
     @staticmethod
     def tag_instr_idx(instr):
         try:
@@ -84,13 +143,55 @@ class AsmCmd(AsmStatement):
             return -1
 
 class AsmBranchCmd(AsmCmd):
-    pass
+    def target(self):
+        ## returns AsmTag, branch target after resolving merged tags
+        asm_tag = self.args[0]
+        if asm_tag.alias is not None:
+            asm_tag = self.args[0] = asm_tag.resolve()
+        return asm_tag
 
 class AsmBuffer:
+    F_EQ_A = '=A'                           ## flag_state: F == A
+
     def __init__(self):
         self.stmt_buf = []                  ## list(AsmStatement asm_stmt)
+        self.flag_state = None              ## None: F undefined, F_EQ_A: F == A, else arg x: F == x
 
     def __call__(self, instr, *args, comment=None):
+        asm_stmt = self.new_statement(instr, *args, comment=comment)
+        self.stmt_buf.append(asm_stmt)
+        self._track_flag_state(asm_stmt)
+
+    def is_flag_coherent(self):
+        ## True if F == A after the last appended statement
+        return self.flag_state is self.F_EQ_A
+
+    def set_flag_coherent(self):
+        self.flag_state = self.F_EQ_A
+
+    def _track_flag_state(self, asm_stmt):
+        state = self.flag_state
+        if not isinstance(asm_stmt, AsmCmd):            ## TAG: jump target, F unknown
+            state = None
+        elif asm_stmt.instr in AsmCmd.F_EQ_A_INSTR:     ## F := A
+            state = self.F_EQ_A
+        elif asm_stmt.instr in ('INR', 'DCR'):          ## F := x
+            state = asm_stmt.args[0]
+        elif asm_stmt.instr == 'LDA':                   ## A := x; F == A if F == x
+            if state is None or state is self.F_EQ_A or not state == asm_stmt.args[0]:
+                state = None
+            else:
+                state = self.F_EQ_A
+        elif asm_stmt.instr in AsmCmd.AF_KEEP_INSTR:    ## A and F unchanged, F == x lost if x is written
+            if state is not None and state is not self.F_EQ_A and asm_stmt.instr in ('STA', 'LD', 'POP') \
+                    and state == asm_stmt.args[0]:
+                state = None
+        else:                                           ## any other instruction, F unknown
+            state = None
+        self.flag_state = state
+
+    @staticmethod
+    def new_statement(instr, *args, comment=None):
         instr = instr.upper()
         tag_instr_idx = AsmCmd.tag_instr_idx(instr)
         if tag_instr_idx < 0:               ## any instruction that doesn't expect a single TAG label argument
@@ -104,50 +205,35 @@ class AsmBuffer:
                 asm_stmt.comment = comment
         else:                               ## BRANCH <label> instruction (BRANCH one of JMP, JNZ, ...)
             asm_stmt = AsmBranchCmd(instr, list(args), comment)
-        self.stmt_buf.append(asm_stmt)
+        return asm_stmt
 
     def replace_instruction(self, find_instr, replace_instr):
         for asm_cmd in self.stmt_buf:
             if isinstance(asm_cmd, AsmCmd) and asm_cmd.instr == find_instr:
                 asm_cmd.instr = replace_instr
 
-    def reduce(self):
-        in_buf = self.stmt_buf
-        out_buf = [in_buf[0]]
-        for curr_stmt in in_buf[1:]:
-            prev_stmt = out_buf[-1]
-            if isinstance(prev_stmt, AsmCmd) and isinstance(curr_stmt, AsmCmd):
-                if prev_stmt.instr == 'RET' and curr_stmt.instr == 'RET':
-                    ## "RET + <RET>" => drop "RET", keep "<RET>"
-                    continue
-                elif prev_stmt.instr == 'JMP' and curr_stmt.instr == 'JMP':
-                    ## "JMP X + <JMP Y>" => drop "JMP Y", keep "<JMP X>"
-                    continue
-                elif prev_stmt.instr == 'STA' and curr_stmt.instr == 'LDA' and prev_stmt.args[0] == curr_stmt.args[0]:
-                    ## "STA X + <LDA X>" => drop "<LDA Y>", keep "STA X"
-                    continue
-            elif isinstance(prev_stmt, AsmTag) and isinstance(curr_stmt, AsmTag):
-                ## "TAG X + <TAG Y>" => replace all uses of "Y" with "X", keep "TAG X", drop "TAG Y"
-                self._replace_tag(curr_stmt, prev_stmt)
-                continue
-            elif isinstance(prev_stmt, AsmTag) and isinstance(curr_stmt, AsmCmd) and curr_stmt.instr == 'JMP':
-                if len(out_buf) > 2 and isinstance(out_buf[-2], AsmCmd) and out_buf[-2].instr == 'JMP':
-                    ## "JMP Z + TAG X + <JMP Y>" => replace all uses of "X" with "Y", drop both "TAG X" and "<JMP Y>"
-                    self._replace_tag(prev_stmt, curr_stmt.args[0])
-                    del out_buf[-1]
-                    continue
-                else:
-                    ## "TAG X + <JMP Y>" => replace all uses of "X" with "Y", drop "TAG X", keep "<JMP Y>"
-                    self._replace_tag(prev_stmt, curr_stmt.args[0])
-                    out_buf[-1] = curr_stmt
-                    continue
-            elif isinstance(prev_stmt, AsmCmd) and isinstance(curr_stmt, AsmTag):
-                if prev_stmt.instr == 'JMP' and prev_stmt.args[0] == curr_stmt:
-                    ## "JMP X + <TAG X>" => drop "JMP X", keep "<TAG X>"
-                    out_buf[-1] = curr_stmt
-                    continue
-            out_buf.append(curr_stmt)
-        self.stmt_buf = out_buf
+    def insert_before(self, find_instr, instr, *args, comment=None):
+        ## insert "instr args" in front of each find_instr command
+        stmt_buf = []
+        for asm_stmt in self.stmt_buf:
+            if isinstance(asm_stmt, AsmCmd) and asm_stmt.instr == find_instr:
+                stmt_buf.append(self.new_statement(instr, *args, comment=comment))
+            stmt_buf.append(asm_stmt)
+        self.stmt_buf = stmt_buf
+
+    def append_buffer(self, asm_buf):
+        ## append the statements of asm_buf, which continues the code of this buffer
+        self.stmt_buf.extend(asm_buf.stmt_buf)
+        self.flag_state = asm_buf.flag_state
+
+    def count_statements(self):
+        ## returns tuple(int cmd_count, int tag_count), number of commands and of tags used as jump targets
+        target_tags = set(asm_stmt.args[0] for asm_stmt in self.stmt_buf if isinstance(asm_stmt, AsmBranchCmd))
+        return sum(1 for asm_stmt in self.stmt_buf if isinstance(asm_stmt, AsmCmd)), \
+            sum(1 for asm_stmt in self.stmt_buf if isinstance(asm_stmt, AsmTag) and asm_stmt in target_tags)
+
+    def reduce(self, peephole):
+        self.stmt_buf = peephole.optimize(self.stmt_buf)
 
     def drop_unused_tags(self, tag_use_count):
         for asm_stmt in self.stmt_buf:
@@ -181,10 +267,719 @@ class AsmBuffer:
                         else:
                             local_asm_vars[asm_var] = True
 
-    def _replace_tag(self, find_tag, replace_tag):
-        for asm_cmd in self.stmt_buf:
-            if isinstance(asm_cmd, AsmBranchCmd) and asm_cmd.args[0] is find_tag:
-                asm_cmd.args[0] = replace_tag
+## ---------------------------------------------------------------------------
+
+class AsmPeepholeRule:
+    def __init__(self, name, pattern, replacement, alias=None):
+        self.name = name                    ## str, rule name
+        self.pattern = self._parse(pattern) ## list(tuple(instrs, args)), statement window to match
+        self.replacement = self._parse(replacement) ## list(tuple(instrs, args)), statements replacing the window
+        self.alias = alias                  ## None or tuple(str find_tag, str replace_tag), tag to replace with another
+
+    @staticmethod
+    def _parse(stmts_str):
+        ## parse "INSTR arg ...; ..." into list(tuple(instrs, args)):
+        ##   INSTR: one or more alternative instructions "A|B", "TAG", "?" (any command) or "$N" (N-th matched statement)
+        ##   arg: name bound to the matched argument, "..." matches any arguments
+        stmts = []
+        for stmt_str in stmts_str.split(';'):
+            tokens = stmt_str.split()
+            if len(tokens) == 0:
+                continue
+            instrs = None if tokens[0] == '?' else tuple(tokens[0].split('|'))
+            args = None if tokens[1:] == ['...'] else tokens[1:]
+            stmts.append((instrs, args))
+        return stmts
+
+    def match(self, window):
+        ## returns None or dict(str name: arg), window statements matching this rule's pattern
+        binding = {}
+        for (instrs, args), asm_stmt in zip(self.pattern, window):
+            if instrs == ('TAG',):
+                if not isinstance(asm_stmt, AsmTag):
+                    return None
+                stmt_args = [asm_stmt]
+            elif not isinstance(asm_stmt, AsmCmd):
+                return None
+            elif instrs is not None and asm_stmt.instr not in instrs:
+                return None
+            elif isinstance(asm_stmt, AsmBranchCmd):
+                stmt_args = [asm_stmt.target()]
+            else:
+                stmt_args = asm_stmt.args
+            if args is not None:
+                if len(args) != len(stmt_args):
+                    return None
+                for name, stmt_arg in zip(args, stmt_args):
+                    if name not in binding:
+                        binding[name] = stmt_arg
+                    elif not (binding[name] is stmt_arg or binding[name] == stmt_arg):
+                        return None
+        return binding
+
+    def replace(self, window, binding):
+        ## returns list(AsmStatement), statements replacing window
+        stmts = []
+        for instrs, args in self.replacement:
+            if instrs[0].startswith('$'):
+                stmts.append(window[int(instrs[0][1:])])
+            else:
+                stmts.append(AsmBuffer.new_statement(instrs[0], *[binding[name] for name in args]))
+        return stmts
+
+class AsmPeepholeOptimizer:
+    RULES = (
+        ## "JMP X + <CMD>" => drop unreachable "<CMD>" up to the next TAG
+        AsmPeepholeRule('unreachable code', 'RET|HALT|JMP ...; ? ...', '$0'),
+        ## "JMP X + TAG X" => drop "JMP X", keep "TAG X"
+        AsmPeepholeRule('jump to next', 'JMP|JZ|JNZ|JP|JM X; TAG X', 'TAG X'),
+        ## "TAG X + TAG Y" => replace all uses of "Y" with "X" (or vice versa), drop "TAG Y"
+        AsmPeepholeRule('tag merge', 'TAG X; TAG Y', 'TAG X', alias=('Y', 'X')),
+        AsmPeepholeRule('tag merge', 'TAG X; TAG Y', 'TAG Y', alias=('X', 'Y')),
+        ## "TAG X + JMP Y" => replace all uses of "X" with "Y", drop "TAG X", keep "JMP Y"
+        AsmPeepholeRule('jump threading', 'TAG X; JMP Y', 'JMP Y', alias=('X', 'Y')),
+        ## "JZ X + JMP Y + TAG X" => "JNZ Y + TAG X"
+        AsmPeepholeRule('branch inversion', 'JZ X; JMP Y; TAG X', 'JNZ Y; TAG X'),
+        AsmPeepholeRule('branch inversion', 'JNZ X; JMP Y; TAG X', 'JZ Y; TAG X'),
+        AsmPeepholeRule('branch inversion', 'JP X; JMP Y; TAG X', 'JM Y; TAG X'),
+        AsmPeepholeRule('branch inversion', 'JM X; JMP Y; TAG X', 'JP Y; TAG X'),
+        ## "STA x + LDA x" => drop "LDA x", keep "STA x"
+        AsmPeepholeRule('store/load', 'STA x; LDA x', 'STA x'),
+        ## "LDA x + STA x" => drop "STA x", keep "LDA x"
+        AsmPeepholeRule('load/store', 'LDA x; STA x', 'LDA x'),
+        ## "LD x a + LDA x" => "LDA a + STA x"
+        AsmPeepholeRule('load forwarding', 'LD x a; LDA x', 'LDA a; STA x'),
+        ## "LDA x + LDA y" => drop "LDA x", keep "LDA y"
+        AsmPeepholeRule('dead load', 'LDA x; LDA y', 'LDA y'),
+        ## "PUSHA + POPA" => drop both
+        AsmPeepholeRule('push/pop', 'PUSHA; POPA', ''))
+
+    def __init__(self, pinned_tags):
+        self.pinned_tags = pinned_tags      ## set(AsmTag), tags referenced from other buffers (function entry points)
+        self.hit_counts = {}                ## dict(str rule_name: int hit_count), optimization statistics
+        self.use_counts = None              ## Counter(AsmTag: int), number of branches to each tag of current buffer
+
+    def optimize(self, stmt_buf):
+        ## apply rules until no rule matches anymore, returns optimized list(AsmStatement)
+        ## merged tags are tracked with AsmTag.alias and branch use counts are kept up to date,
+        ## so that each iteration is a linear pass over stmt_buf
+        self.use_counts = collections.Counter(asm_stmt.target()
+            for asm_stmt in stmt_buf if isinstance(asm_stmt, AsmBranchCmd))
+        changed = True
+        while changed:
+            stmt_buf, changed = self._apply_window_rules(stmt_buf)
+            stmt_buf, jmp_changed = self._replace_jumps_to_return(stmt_buf)
+            stmt_buf, tag_changed = self._drop_unused_tags(stmt_buf)
+            changed = changed or jmp_changed or tag_changed
+        for asm_stmt in stmt_buf:
+            if isinstance(asm_stmt, AsmBranchCmd):
+                asm_stmt.target()           ## leave no merged tags behind
+        self.use_counts = None
+        return stmt_buf
+
+    ## Private functions
+
+    def _count_hit(self, rule_name):
+        self.hit_counts[rule_name] = self.hit_counts.get(rule_name, 0) + 1
+
+    def _is_unused(self, asm_tag):
+        return self.use_counts[asm_tag] == 0 and asm_tag not in self.pinned_tags
+
+    def _count_uses(self, asm_stmts, increment):
+        for asm_stmt in asm_stmts:
+            if isinstance(asm_stmt, AsmBranchCmd):
+                self.use_counts[asm_stmt.target()] += increment
+
+    def _apply_window_rules(self, stmt_buf):
+        ## slide rule windows over the statements, replaced statements are re-examined
+        ## together with the statements preceding them
+        pending = list(reversed(stmt_buf))  ## list(AsmStatement), stack of statements to examine
+        out_buf = []                        ## list(AsmStatement), examined statements
+        changed = False
+        while len(pending) > 0:
+            asm_stmt = pending.pop()
+            if isinstance(asm_stmt, AsmTag) and self._is_unused(asm_stmt):
+                self._count_hit('unused tag')
+                changed = True
+                continue
+            out_buf.append(asm_stmt)
+            for rule in self.RULES:
+                n_window = len(rule.pattern)
+                if len(out_buf) < n_window:
+                    continue
+                window = out_buf[-n_window:]
+                binding = rule.match(window)
+                if binding is None:
+                    continue
+                if rule.alias is not None:
+                    find_tag, replace_tag = binding[rule.alias[0]], binding[rule.alias[1]]
+                    if find_tag in self.pinned_tags or find_tag is replace_tag:
+                        continue
+                    find_tag.merge_into(replace_tag)
+                    self.use_counts[replace_tag] += self.use_counts.pop(find_tag, 0)
+                del out_buf[-n_window:]
+                replacement = rule.replace(window, binding)
+                self._count_uses(window, -1)
+                self._count_uses(replacement, 1)
+                pending.extend(reversed(replacement))
+                self._count_hit(rule.name)
+                changed = True
+                break
+        return out_buf, changed
+
+    def _replace_jumps_to_return(self, stmt_buf):
+        ## "JMP X" => "RET" if "TAG X" is followed by "RET" (or "HALT")
+        tag_target = {}
+        target_stmt = None
+        for asm_stmt in reversed(stmt_buf):
+            if isinstance(asm_stmt, AsmTag):
+                tag_target[asm_stmt] = target_stmt
+            else:
+                target_stmt = asm_stmt
+        changed = False
+        for i_stmt, asm_stmt in enumerate(stmt_buf):
+            if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'JMP':
+                target_stmt = tag_target.get(asm_stmt.target(), None)
+                if isinstance(target_stmt, AsmCmd) and target_stmt.instr in ('RET', 'HALT'):
+                    self.use_counts[asm_stmt.target()] -= 1
+                    stmt_buf[i_stmt] = AsmBuffer.new_statement(target_stmt.instr, comment=asm_stmt.comment)
+                    self._count_hit('jump to return')
+                    changed = True
+        return stmt_buf, changed
+
+    def _drop_unused_tags(self, stmt_buf):
+        ## drop tags whose last use vanished after the window pass examined them
+        out_buf = [asm_stmt for asm_stmt in stmt_buf if not isinstance(asm_stmt, AsmTag) or
+            not self._is_unused(asm_stmt)]
+        for i in range(len(stmt_buf) - len(out_buf)):
+            self._count_hit('unused tag')
+        return out_buf, len(out_buf) != len(stmt_buf)
+
+## ---------------------------------------------------------------------------
+
+class AsmCfg:
+    ## basic-block control flow graph of an AsmBuffer: blocks start at a TAG or after a branch,
+    ## RET or HALT, they end with a branch, RET or HALT or fall through into the next block
+    def __init__(self, stmt_buf):
+        self.stmt_buf = stmt_buf            ## list(AsmStatement asm_stmt), statements of the graph
+        self.is_analyzable = True           ## bool, False: control flow could not be fully analyzed
+        self.callee_tags = set()            ## set(AsmTag), CALL targets outside of this buffer
+        self.blocks = []                    ## list(tuple(int i_first, int i_end)), statement range of each block
+        self.successors = []                ## list(list(int i_block)), control flow successors of each block
+        self.tag_block = {}                 ## dict(AsmTag asm_tag: int i_block), block starting with TAG asm_tag
+        self._build()
+
+    def reachable(self, entry_tags):
+        ## returns set(int i_block), blocks reachable from the first block or from one of entry_tags
+        pending = [0] if len(self.blocks) > 0 else []
+        pending += [self.tag_block[asm_tag] for asm_tag in entry_tags if asm_tag in self.tag_block]
+        visited = set()
+        while len(pending) > 0:
+            i_block = pending.pop()
+            if i_block not in visited:
+                visited.add(i_block)
+                pending.extend(self.successors[i_block])
+        return visited
+
+    def _build(self):
+        i_first = 0
+        for i_stmt, asm_stmt in enumerate(self.stmt_buf):
+            if isinstance(asm_stmt, AsmTag) and i_stmt > i_first:
+                self.blocks.append((i_first, i_stmt))
+                i_first = i_stmt
+            if isinstance(asm_stmt, AsmTag):
+                self.tag_block[asm_stmt] = len(self.blocks)
+            elif (isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr != 'CALL') \
+                    or (isinstance(asm_stmt, AsmCmd) and asm_stmt.instr in ('RET', 'HALT')):
+                self.blocks.append((i_first, i_stmt + 1))
+                i_first = i_stmt + 1
+        if i_first < len(self.stmt_buf):
+            self.blocks.append((i_first, len(self.stmt_buf)))
+        n_blocks = len(self.blocks)
+        for i_block, (i_first, i_end) in enumerate(self.blocks):
+            next_block = [i_block + 1] if i_block + 1 < n_blocks else []
+            successors = next_block
+            for asm_stmt in self.stmt_buf[i_first:i_end]:
+                if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'CALL':
+                    if asm_stmt.args[0] in self.tag_block:
+                        ## CALL into a local TAG (asm() subroutine), RET does not end the function
+                        self.is_analyzable = False
+                    self.callee_tags.add(asm_stmt.args[0])
+            asm_stmt = self.stmt_buf[i_end - 1]
+            if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr != 'CALL':
+                asm_tag = asm_stmt.args[0]
+                if asm_tag not in self.tag_block:
+                    self.is_analyzable = False
+                elif asm_stmt.instr == 'JMP':
+                    successors = [self.tag_block[asm_tag]]
+                else:
+                    successors = [self.tag_block[asm_tag]] + next_block
+            elif isinstance(asm_stmt, AsmCmd) and asm_stmt.instr in ('RET', 'HALT'):
+                successors = []
+            self.successors.append(successors)
+
+class AsmLiveness:
+    def __init__(self, asm_buf, call_reads):
+        self.stmt_buf = asm_buf.stmt_buf    ## list(AsmStatement asm_stmt), analyzed statements
+        self.call_reads = call_reads        ## dict(AsmTag func_tag: list(AsmVar)), variables read by "CALL func_tag"
+        self.cfg = AsmCfg(self.stmt_buf)    ## AsmCfg, basic blocks of the analyzed statements
+        self.is_analyzable = self.cfg.is_analyzable ## bool, False: control flow could not be fully analyzed
+        self.callee_tags = self.cfg.callee_tags     ## set(AsmTag), CALL targets outside of this buffer
+        self.live_in = []                   ## list(set(AsmVar)), variables live before each statement
+        self.live_out = []                  ## list(set(AsmVar)), variables live after each statement
+        self._analyze()
+
+    def stmt_var_access(self, i_stmt):
+        ## returns tuple(list(AsmVar) read_vars, list(AsmVar) written_vars) of statement i_stmt
+        asm_stmt = self.stmt_buf[i_stmt]
+        if isinstance(asm_stmt, AsmBranchCmd):
+            if asm_stmt.instr == 'CALL':
+                return self.call_reads.get(asm_stmt.args[0], []), []
+            return [], []
+        elif isinstance(asm_stmt, AsmCmd):
+            return asm_stmt.var_access()
+        return [], []
+
+    def _analyze(self):
+        blocks, successors = self.cfg.blocks, self.cfg.successors
+        n_stmts = len(self.stmt_buf)
+        var_access = [self.stmt_var_access(i_stmt) for i_stmt in range(n_stmts)]
+        ## summarize each block: used = read before written in block, killed = written in block
+        block_used, block_killed = [], []
+        for i_first, i_end in blocks:
+            used, killed = set(), set()
+            for i_stmt in range(i_end - 1, i_first - 1, -1):
+                read_vars, written_vars = var_access[i_stmt]
+                used = (used - set(written_vars)) | set(read_vars)
+                killed |= set(written_vars)
+            block_used.append(used)
+            block_killed.append(killed)
+        ## iterate backward dataflow equations over the blocks until fixpoint:
+        ##   live_out(b) = U live_in(succ(b)), live_in(b) = used(b) | (live_out(b) - killed(b))
+        block_live_in = list(block_used)
+        block_live_out = [set() for i_block in range(len(blocks))]
+        changed = True
+        while changed:
+            changed = False
+            for i_block in range(len(blocks) - 1, -1, -1):
+                live_out = set()
+                for i_succ in successors[i_block]:
+                    live_out |= block_live_in[i_succ]
+                if live_out != block_live_out[i_block]:
+                    block_live_out[i_block] = live_out
+                    block_live_in[i_block] = block_used[i_block] | (live_out - block_killed[i_block])
+                    changed = True
+        ## propagate block results to the statements of each block
+        self.live_in = [set() for i_stmt in range(n_stmts)]
+        self.live_out = [set() for i_stmt in range(n_stmts)]
+        for i_block, (i_first, i_end) in enumerate(blocks):
+            live = block_live_out[i_block]
+            for i_stmt in range(i_end - 1, i_first - 1, -1):
+                self.live_out[i_stmt] = live
+                read_vars, written_vars = var_access[i_stmt]
+                live = (live - set(written_vars)) | set(read_vars)
+                self.live_in[i_stmt] = live
+
+class AsmDeadCodeEliminator:
+    ## drops basic blocks that cannot be reached and stores to local variables that are never read
+    DEAD_STORE_INSTR = ('STA', 'LD')        ## instructions that only write a variable, without side effects on A and F
+    ## dict(str instr: tuple(str read, str written)), accumulator and flag access ('A', 'F') of instructions
+    ## without side effects, other instructions are treated as reading A and F and are never dropped
+    PURE_INSTR_AF = {'LDA': ('', 'A'), 'CMP': ('A', 'F'),
+        **{instr: ('A', 'AF') for instr in ('ADD', 'SUB', 'MLT', 'AND', 'OR', 'XOR', 'RLA', 'RRA')}}
+    ## dict(str instr: tuple(str read, str written)), accumulator and flag access of other known instructions
+    INSTR_AF = {'STA': ('A', ''), 'PUSHA': ('A', ''), 'XA': ('A', 'A'), 'INR': ('', 'F'), 'DCR': ('', 'F'),
+        'LD': ('', ''), 'PUSH': ('', ''), 'POP': ('', ''), 'JMP': ('', ''),
+        'JZ': ('F', ''), 'JNZ': ('F', ''), 'JP': ('F', ''), 'JM': ('F', '')}
+
+    def __init__(self, pinned_tags, call_reads):
+        self.pinned_tags = pinned_tags      ## set(AsmTag), tags referenced from other buffers (function entry points)
+        self.call_reads = call_reads        ## dict(AsmTag func_tag: list(AsmVar)), variables read by "CALL func_tag"
+        self.hit_counts = {}                ## dict(str name: int hit_count), optimization statistics
+        self.persistent_vars = set()        ## set(AsmVar), local variables keeping their value between calls
+        self.entry_reads = {}               ## dict(AsmTag func_tag: str), 'A' and 'F' if read by "CALL func_tag"
+
+    def eliminate(self, func_asm_bufs, peephole=None):
+        ## func_asm_bufs: list(tuple(UserDefFunction function, AsmBuffer asm_buf)), function bodies to optimize
+        ## peephole: None or AsmPeepholeOptimizer, reduces changed buffers between iterations
+        ## local variables that may be read before they are written in any function body keep
+        ## their value until the next call (or in-line expansion) and are never dead, just like
+        ## all local variables accessed in function bodies whose control flow cannot be analyzed
+        ## arguments a function body does not read before writing them are no longer passed by its
+        ## callers (UserDefFunction.passed_arg_vars), their stores in front of each CALL are dead
+        for function, asm_buf in func_asm_bufs:
+            self.entry_reads[function.asm_tag] = self._entry_reads(asm_buf.stmt_buf)
+            liveness = AsmLiveness(asm_buf, self.call_reads)
+            if function.asm_tag in self.call_reads and liveness.is_analyzable and len(asm_buf.stmt_buf) > 0:
+                function.passed_arg_vars = [asm_var for asm_var in function.passed_arg_vars
+                    if asm_var in liveness.live_in[0]]
+                self.call_reads[function.asm_tag] = function.passed_arg_vars
+        for function, asm_buf in func_asm_bufs:
+            liveness = AsmLiveness(asm_buf, self.call_reads)
+            if not liveness.is_analyzable:
+                for i_stmt in range(len(asm_buf.stmt_buf)):
+                    read_vars, written_vars = liveness.stmt_var_access(i_stmt)
+                    self.persistent_vars.update(read_vars + written_vars)
+            elif len(asm_buf.stmt_buf) > 0:
+                self.persistent_vars |= liveness.live_in[0]
+        for function, asm_buf in func_asm_bufs:
+            while self._drop_unreachable_blocks(asm_buf) | self._drop_dead_stores(asm_buf) \
+                    | self._forward_stores(asm_buf) | self._drop_dead_computations(asm_buf, function.has_return):
+                if peephole is not None:
+                    asm_buf.reduce(peephole)
+
+    ## Private functions
+
+    def _count_hit(self, name, hit_count):
+        if hit_count > 0:
+            self.hit_counts[name] = self.hit_counts.get(name, 0) + hit_count
+
+    def _entry_reads(self, stmt_buf):
+        ## returns str, 'A' and 'F' if the function body stmt_buf may read them before writing them,
+        ## the entry block is followed up to the first instruction of unknown accumulator or flag access
+        read, written = '', ''
+        for i_stmt, asm_stmt in enumerate(stmt_buf):
+            if isinstance(asm_stmt, AsmTag) and i_stmt == 0:
+                continue
+            instr_af = None
+            if isinstance(asm_stmt, AsmCmd):
+                instr_af = self.PURE_INSTR_AF.get(asm_stmt.instr, self.INSTR_AF.get(asm_stmt.instr))
+            if instr_af is None:
+                break
+            read += ''.join(reg for reg in instr_af[0] if reg not in written)
+            written += instr_af[1]
+            if isinstance(asm_stmt, AsmBranchCmd):
+                break
+        return ''.join(reg for reg in 'AF' if reg in read or reg not in written)
+
+    def _drop_unreachable_blocks(self, asm_buf):
+        cfg = AsmCfg(asm_buf.stmt_buf)
+        if not cfg.is_analyzable:
+            return False
+        reachable = cfg.reachable(self.pinned_tags)
+        if len(reachable) == len(cfg.blocks):
+            return False
+        stmt_buf = []
+        for i_block, (i_first, i_end) in enumerate(cfg.blocks):
+            if i_block in reachable:
+                stmt_buf.extend(asm_buf.stmt_buf[i_first:i_end])
+        self._count_hit('unreachable statement', len(asm_buf.stmt_buf) - len(stmt_buf))
+        asm_buf.stmt_buf = stmt_buf
+        return True
+
+    def _drop_dead_stores(self, asm_buf):
+        liveness = AsmLiveness(asm_buf, self.call_reads)
+        if not liveness.is_analyzable:
+            return False
+        stmt_buf = []
+        for i_stmt, asm_stmt in enumerate(asm_buf.stmt_buf):
+            if isinstance(asm_stmt, AsmCmd) and asm_stmt.instr in self.DEAD_STORE_INSTR:
+                asm_var = asm_stmt.args[0]
+                if isinstance(asm_var, AsmVar) and asm_var.var_sym.context_function is not None \
+                        and asm_var not in self.persistent_vars and asm_var not in liveness.live_out[i_stmt]:
+                    continue
+            stmt_buf.append(asm_stmt)
+        self._count_hit('dead store', len(asm_buf.stmt_buf) - len(stmt_buf))
+        changed = len(stmt_buf) != len(asm_buf.stmt_buf)
+        asm_buf.stmt_buf = stmt_buf
+        return changed
+
+    def _forward_stores(self, asm_buf):
+        ## "STA x; LD y x" => "STA y" if x is a local variable that is dead after the copy, like a
+        ## temporary holding a return value or the result of an expression until it is assigned
+        liveness = AsmLiveness(asm_buf, self.call_reads)
+        if not liveness.is_analyzable:
+            return False
+        stmt_buf = []
+        i_stmt = 0
+        while i_stmt < len(asm_buf.stmt_buf):
+            asm_stmt = asm_buf.stmt_buf[i_stmt]
+            next_stmt = asm_buf.stmt_buf[i_stmt + 1] if i_stmt + 1 < len(asm_buf.stmt_buf) else None
+            if isinstance(asm_stmt, AsmCmd) and asm_stmt.instr == 'STA' and isinstance(next_stmt, AsmCmd) \
+                    and next_stmt.instr == 'LD' and next_stmt.args[1] is asm_stmt.args[0]:
+                asm_var = asm_stmt.args[0]
+                if isinstance(asm_var, AsmVar) and asm_var.var_sym.context_function is not None \
+                        and next_stmt.args[0] is not asm_var and asm_var not in self.persistent_vars \
+                        and asm_var not in liveness.live_out[i_stmt + 1]:
+                    forward_cmd = AsmCmd('STA', next_stmt.args[:1], next_stmt.comment)
+                    forward_cmd.coord = next_stmt.coord
+                    stmt_buf.append(forward_cmd)
+                    i_stmt += 2
+                    continue
+            stmt_buf.append(asm_stmt)
+            i_stmt += 1
+        self._count_hit('forwarded store', len(asm_buf.stmt_buf) - len(stmt_buf))
+        changed = len(stmt_buf) != len(asm_buf.stmt_buf)
+        asm_buf.stmt_buf = stmt_buf
+        return changed
+
+    def _drop_dead_computations(self, asm_buf, has_return):
+        ## drop side effect free instructions whose A and F results are overwritten before they are read,
+        ## A and F are assumed to be live at the end of each block, except after HALT and RET, where
+        ## only the return value in A is live
+        cfg = AsmCfg(asm_buf.stmt_buf)
+        stmt_buf = []
+        for i_first, i_end in reversed(cfg.blocks):
+            block_buf = []
+            live = set('AF')
+            for asm_stmt in reversed(asm_buf.stmt_buf[i_first:i_end]):
+                if isinstance(asm_stmt, AsmCmd) and asm_stmt.instr in ('RET', 'HALT'):
+                    live = set('A') if asm_stmt.instr == 'RET' and has_return else set()
+                elif isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'CALL' \
+                        and asm_stmt.args[0] in self.entry_reads:
+                    live = set(self.entry_reads[asm_stmt.args[0]])
+                elif isinstance(asm_stmt, AsmCmd) and asm_stmt.instr in self.PURE_INSTR_AF:
+                    read, written = self.PURE_INSTR_AF[asm_stmt.instr]
+                    if not live & set(written):
+                        continue
+                    live = (live - set(written)) | set(read)
+                elif isinstance(asm_stmt, AsmCmd) and asm_stmt.instr in self.INSTR_AF:
+                    read, written = self.INSTR_AF[asm_stmt.instr]
+                    live = (live - set(written)) | set(read)
+                elif isinstance(asm_stmt, AsmCmd):
+                    live = set('AF')
+                block_buf.append(asm_stmt)
+            stmt_buf.extend(block_buf)
+        stmt_buf.reverse()
+        self._count_hit('dead computation', len(asm_buf.stmt_buf) - len(stmt_buf))
+        changed = len(stmt_buf) != len(asm_buf.stmt_buf)
+        asm_buf.stmt_buf = stmt_buf
+        return changed
+
+class VmVariableAllocator:
+    def __init__(self, var_nr_base):
+        self.var_nr_base = var_nr_base      ## int, number of the first VM variable available for C variables
+        self.interference = {}              ## dict(AsmVar asm_var: set(AsmVar)), interference graph of local variables
+        self.pinned_vars = {}               ## dict(AsmVar asm_var: any), ordered set of local variables with a dedicated VM variable
+        self.var_count = var_nr_base        ## int, total number of variables
+
+    def allocate(self, func_asm_bufs, global_asm_vars, local_asm_vars):
+        ## func_asm_bufs: list(tuple(UserDefFunction function, AsmBuffer asm_buf)), function bodies to analyze
+        for asm_var in local_asm_vars:
+            self.interference[asm_var] = set()
+        func_by_tag = {function.asm_tag: function for function, asm_buf in func_asm_bufs}
+        call_reads = {function.asm_tag: function.passed_arg_vars for function, asm_buf in func_asm_bufs}
+        func_locals = collections.defaultdict(set)
+        for asm_var in local_asm_vars:
+            func_locals[asm_var.var_sym.context_function].add(asm_var)
+        ## analyze liveness of local variables in each function body
+        func_liveness = []
+        callees = {}                        ## dict(UserDefFunction function: set(UserDefFunction)), call graph
+        for function, asm_buf in func_asm_bufs:
+            liveness = AsmLiveness(asm_buf, call_reads)
+            func_liveness.append((function, liveness))
+            ## locals of in-line expanded functions are part of the frame of the function they were expanded into
+            for i_stmt in range(len(liveness.stmt_buf)):
+                read_vars, written_vars = liveness.stmt_var_access(i_stmt)
+                func_locals[function].update(asm_var for asm_var in read_vars + written_vars if asm_var in self.interference)
+            callees[function] = set(func_by_tag[asm_tag] for asm_tag in liveness.callee_tags if asm_tag in func_by_tag)
+        reachable = self._reachable(callees)
+        ## build interference graph
+        for function, liveness in func_liveness:
+            self._add_interference(function, liveness, func_by_tag, reachable, func_locals)
+        ## bind global and pinned local variables to dedicated VM variables
+        var_nr = self.var_nr_base
+        for asm_var in list(global_asm_vars) + list(self.pinned_vars):
+            asm_var.bind(var_nr)
+            var_nr += 1
+        ## bind remaining local variables of all functions, local variables share VM variables where
+        ## their live ranges do not overlap, including locals of functions that are never active together
+        asm_vars = [asm_var for asm_var in local_asm_vars if asm_var not in self.pinned_vars]
+        colors = self._color(asm_vars)
+        for asm_var in asm_vars:
+            asm_var.bind(var_nr + colors[asm_var])
+        var_nr += max(colors.values(), default=-1) + 1
+        self.var_count = var_nr
+        return var_nr
+
+    def _reachable(self, callees):
+        ## returns dict(UserDefFunction function: set(UserDefFunction)), functions that may
+        ## become active while function is called (function itself and its direct or indirect callees)
+        reachable = {}
+        for function in callees:
+            visited = set()
+            pending = [function]
+            while len(pending) > 0:
+                callee = pending.pop()
+                if callee not in visited:
+                    visited.add(callee)
+                    pending.extend(callees.get(callee, ()))
+            reachable[function] = visited
+        return reachable
+
+    def _add_interference(self, function, liveness, func_by_tag, reachable, func_locals):
+        is_local = lambda asm_var: asm_var in self.interference
+        stmt_buf = liveness.stmt_buf
+        if not liveness.is_analyzable:
+            ## pin all local variables accessed within function
+            for i_stmt in range(len(stmt_buf)):
+                read_vars, written_vars = liveness.stmt_var_access(i_stmt)
+                for asm_var in filter(is_local, read_vars + written_vars):
+                    self.pinned_vars[asm_var] = True
+            return
+        if len(stmt_buf) > 0:
+            ## variables live at function entry: arguments interfere with each other, uninitialized
+            ## local variables keep their value between calls and are pinned
+            entry_vars = list(filter(is_local, liveness.live_in[0]))
+            for asm_var in entry_vars:
+                if asm_var not in function.arg_vars:
+                    self.pinned_vars[asm_var] = True
+            self._add_edges(entry_vars, entry_vars)
+        for i_stmt, asm_stmt in enumerate(stmt_buf):
+            live_out = list(filter(is_local, liveness.live_out[i_stmt]))
+            ## written variables interfere with all variables live after the statement
+            read_vars, written_vars = liveness.stmt_var_access(i_stmt)
+            self._add_edges(filter(is_local, written_vars), live_out)
+            ## variables live across a CALL interfere with all local variables of the called function
+            ## and of all functions it may call in turn (its frame overlay), this includes the
+            ## variables of the calling function itself in case of a recursive CALL
+            if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'CALL':
+                callee = func_by_tag.get(asm_stmt.args[0], None)
+                if callee is not None:
+                    for active_function in reachable[callee]:
+                        self._add_edges(live_out, func_locals[active_function])
+
+    def _add_edges(self, asm_vars_a, asm_vars_b):
+        asm_vars_b = list(asm_vars_b)
+        for asm_var_a in asm_vars_a:
+            for asm_var_b in asm_vars_b:
+                if asm_var_a is not asm_var_b:
+                    self.interference[asm_var_a].add(asm_var_b)
+                    self.interference[asm_var_b].add(asm_var_a)
+
+    def _color(self, asm_vars):
+        ## greedy graph coloring in smallest-last order, returns dict(AsmVar asm_var: int color)
+        asm_var_set = set(asm_vars)
+        degree = {asm_var: len(self.interference[asm_var] & asm_var_set) for asm_var in asm_vars}
+        pending = list(asm_vars)
+        order = []
+        while len(pending) > 0:
+            asm_var = min(pending, key=lambda v: degree[v])
+            pending.remove(asm_var)
+            order.append(asm_var)
+            for neighbour in self.interference[asm_var]:
+                if neighbour in degree:
+                    degree[neighbour] -= 1
+        colors = {}
+        for asm_var in reversed(order):
+            used_colors = set(colors[v] for v in self.interference[asm_var] if v in colors)
+            color = 0
+            while color in used_colors:
+                color += 1
+            colors[asm_var] = color
+        return colors
+
+class AsmProfiler:
+    ## counts the executions of basic blocks in spare VM variables, each block gets an "INR counter" at
+    ## its first point where F is dead, right before HALT a dump subroutine hands the counters over to
+    ## the host in chunks of nine in p0 ... p8, each chunk announced by p9 := PROFILE_DUMP_MARK + chunk
+    ## number and acknowledged by the host clearing p9 (pigpio's update_script(), see pipcc.py), the
+    ## script's parameters are saved and restored around the dump
+    F_KEEP_INSTR = ('LDA', 'STA', 'LD', 'POP', 'PUSH', 'PUSHA')     ## instructions that neither read nor write F
+    F_WRITE_INSTR = AsmCmd.F_EQ_A_INSTR + ('CMP', 'INR', 'DCR')     ## instructions that write F without reading it
+    CHUNK_SIZE = 9                          ## number of counters handed over per chunk
+
+    def __init__(self, c_sources, log):
+        self.c_sources = c_sources          ## CSourceBundle, maps the positions of counted commands
+        self.log = log                      ## PccLogger, log sink
+        self.counters = []                  ## list(tuple(AsmVar counter_var, str func_name, str filename, int row, bool is_entry))
+
+    def instrument(self, func_asm_bufs, var_nr_base):
+        ## func_asm_bufs: list(tuple(UserDefFunction function, AsmBuffer asm_buf)), main() (the script
+        ## entry) first, returns None or AsmBuffer, the dump subroutine to append to the script
+        ## var_nr_base: int, number of the first spare VM variable
+        insert_points = []                  ## list(tuple(AsmBuffer asm_buf, int i_stmt, str func_name, c_ast Coord, bool is_entry))
+        for function, asm_buf in func_asm_bufs:
+            cfg = AsmCfg(asm_buf.stmt_buf)
+            for i_block, (i_first, i_end) in enumerate(cfg.blocks):
+                i_stmt = self._counter_position(asm_buf.stmt_buf, i_first, i_end, i_block == 0)
+                coord = self._block_coord(asm_buf.stmt_buf, i_first, i_end)
+                if i_stmt is not None and coord is not None:
+                    insert_points.append((asm_buf, i_stmt, function.func_name, coord, i_block == 0))
+        n_counters = min(len(insert_points), VM_MAX_VARS - var_nr_base - 10)
+        if n_counters < len(insert_points):
+            self.log.warning(None, f'profile: {max(n_counters, 0)} of {len(insert_points)} basic blocks counted, '
+                'out of VM variables', None)
+        if n_counters <= 0:
+            return None
+        ## bind counters and parameter save area to spare VM variables
+        counters_at = {}                    ## dict(tuple(int id(asm_buf), int i_stmt): list(AsmVar counter_var))
+        for asm_buf, i_stmt, func_name, coord, is_entry in insert_points[:n_counters]:
+            counter_var = AsmVar()
+            filename, row = self.c_sources.map_coord(coord.line)
+            self.counters.append((counter_var, func_name, filename, row, is_entry))
+            counters_at.setdefault((id(asm_buf), i_stmt), []).append(counter_var)
+        save_vars = [AsmVar() for i_param in range(10)]
+        for i_var, asm_var in enumerate([counter[0] for counter in self.counters] + save_vars):
+            asm_var.bind(var_nr_base + i_var)
+        ## insert counters, clear them at the script entry and dump them before HALT
+        dump_tag = AsmTag()
+        for i_func, (function, asm_buf) in enumerate(func_asm_bufs):
+            stmt_buf = []
+            if i_func == 0:
+                for counter_var, func_name, filename, row, is_entry in self.counters:
+                    stmt_buf.append(AsmBuffer.new_statement('LD', counter_var, 0,
+                        comment=f'profile counter {PurePath(filename or "").name}:{row}'))
+            for i_stmt, asm_stmt in enumerate(asm_buf.stmt_buf):
+                for counter_var in counters_at.get((id(asm_buf), i_stmt), []):
+                    stmt_buf.append(AsmBuffer.new_statement('INR', counter_var, comment='count block'))
+                if isinstance(asm_stmt, AsmCmd) and asm_stmt.instr == 'HALT':
+                    stmt_buf.append(AsmBuffer.new_statement('CALL', dump_tag, comment='dump profile counters'))
+                stmt_buf.append(asm_stmt)
+            asm_buf.stmt_buf = stmt_buf
+        return self._dump_subroutine(dump_tag, save_vars)
+
+    ## Private functions
+
+    def _counter_position(self, stmt_buf, i_first, i_end, is_entry):
+        ## returns None or int, index of the first statement of the block in front of which F is dead
+        i_stmt = i_first
+        while i_stmt < i_end and isinstance(stmt_buf[i_stmt], AsmTag):
+            i_stmt += 1
+        if is_entry:                        ## F is undefined at the script and function entries
+            return i_stmt if i_stmt < i_end else None
+        for i_stmt in range(i_stmt, i_end):
+            asm_stmt = stmt_buf[i_stmt]
+            if isinstance(asm_stmt, AsmBranchCmd) or not isinstance(asm_stmt, AsmCmd):
+                return None
+            elif asm_stmt.instr in self.F_WRITE_INSTR or asm_stmt.instr == 'HALT':
+                return i_stmt
+            elif asm_stmt.instr not in self.F_KEEP_INSTR:
+                return None
+        return None
+
+    @staticmethod
+    def _block_coord(stmt_buf, i_first, i_end):
+        ## returns None or c_ast Coord, position of the first C statement compiled into the block, blocks
+        ## without own position (e.g. peephole results) continue the statement in front of them
+        for i_stmt in list(range(i_first, i_end)) + list(range(i_first - 1, -1, -1)):
+            asm_stmt = stmt_buf[i_stmt]
+            if isinstance(asm_stmt, AsmCmd) and asm_stmt.coord is not None:
+                return asm_stmt.coord
+        return None
+
+    def _dump_subroutine(self, dump_tag, save_vars):
+        asm_out = AsmBuffer()
+        wait_tag = AsmTag()
+        asm_out('TAG', dump_tag, comment='profile counter dump')
+        for i_param, save_var in enumerate(save_vars):
+            asm_out('LD', save_var, f'p{i_param}')
+        counter_vars = [counter[0] for counter in self.counters]
+        for i_chunk in range(0, len(counter_vars), self.CHUNK_SIZE):
+            for i_param, counter_var in enumerate(counter_vars[i_chunk:i_chunk + self.CHUNK_SIZE]):
+                asm_out('LD', f'p{i_param}', counter_var)
+            asm_out('LD', 'p9', str(PROFILE_DUMP_MARK + i_chunk // self.CHUNK_SIZE))
+            asm_out('CALL', wait_tag)
+        for i_param, save_var in enumerate(save_vars):
+            asm_out('LD', f'p{i_param}', save_var)
+        asm_out('RET')
+        asm_out('TAG', wait_tag, comment='wait for the host to clear p9')
+        asm_out('MILS', 1)
+        asm_out('LDA', 'p9')
+        asm_out('CMP', 0)
+        asm_out('JNZ', wait_tag)
+        asm_out('RET')
+        return asm_out
 
 ## ---------------------------------------------------------------------------
 
@@ -229,6 +1024,97 @@ class EmulatedInstrs:
     def asm_bufs(self):
         return [instr_func.asm_buf for instr_func in self.instr_funcs.values()]
 
+    def inline_calls(self, asm_bufs, opt_level, tag_count, stmt_count):
+        ## replace CALLs of emulated instructions in asm_bufs with in-line expansions of their bodies,
+        ## returns list(AsmBuffer) of modified buffers
+        ## cost model: a call site is expanded if its instruction has only a single call site (saves
+        ## CALL, RET and the entry TAG), or at opt_level "1" if it is inside a loop, or at opt_level
+        ## "2" anywhere, as long as the program stays within VM_MAX_TAGS and INLINE_MAX_STMT_COUNT,
+        ## sites in the most deeply nested loops are expanded first
+        if opt_level == '0' or len(self.instr_funcs) == 0:
+            return []
+        instr_by_tag = {instr_func.asm_tag: instr for instr, instr_func in self.instr_funcs.items()}
+        call_sites = []                 ## list(tuple(int loop_depth, AsmBuffer asm_buf, AsmBranchCmd asm_cmd))
+        call_count = {}                 ## dict(str instr: int count), number of call sites per instruction
+        for asm_buf in asm_bufs:
+            loop_depth = self._loop_depth(asm_buf.stmt_buf)
+            for i_stmt, asm_stmt in enumerate(asm_buf.stmt_buf):
+                if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'CALL' and asm_stmt.args[0] in instr_by_tag:
+                    call_sites.append((loop_depth[i_stmt], asm_buf, asm_stmt))
+                    instr = instr_by_tag[asm_stmt.args[0]]
+                    call_count[instr] = call_count.get(instr, 0) + 1
+        inlined_sites = set()           ## set(AsmBranchCmd), CALL statements to expand
+        for loop_depth, asm_buf, asm_cmd in sorted(call_sites, key=lambda site: -site[0]):
+            instr = instr_by_tag[asm_cmd.args[0]]
+            if call_count[instr] > 1 and (opt_level == 's' or (opt_level == '1' and loop_depth == 0)):
+                continue
+            n_stmts, n_tags = self._expansion_cost(instr)
+            if tag_count + n_tags > VM_MAX_TAGS or stmt_count + n_stmts > INLINE_MAX_STMT_COUNT:
+                continue
+            tag_count += n_tags
+            stmt_count += n_stmts
+            inlined_sites.add(asm_cmd)
+        modified_bufs = []
+        for asm_buf in asm_bufs:
+            if any(asm_stmt in inlined_sites for asm_stmt in asm_buf.stmt_buf):
+                asm_buf.stmt_buf = self._expand_calls(asm_buf.stmt_buf, inlined_sites, instr_by_tag)
+                modified_bufs.append(asm_buf)
+        called_tags = set()
+        for asm_buf in asm_bufs:
+            called_tags.update(asm_stmt.args[0] for asm_stmt in asm_buf.stmt_buf
+                if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'CALL')
+        for asm_tag, instr in instr_by_tag.items():
+            if asm_tag not in called_tags:
+                del self.instr_funcs[instr]
+        return modified_bufs
+
+    def _expand_calls(self, stmt_buf, inlined_sites, instr_by_tag):
+        out_buf = []
+        for asm_stmt in stmt_buf:
+            if asm_stmt not in inlined_sites:
+                out_buf.append(asm_stmt)
+                continue
+            ## "LD SCR0 x + CALL instr" => use x directly, SCR0 is consumed by the emulated instruction
+            x = SCR0
+            if len(out_buf) > 0 and isinstance(out_buf[-1], AsmCmd) and out_buf[-1].instr == 'LD' \
+                    and out_buf[-1].args[0] == SCR0:
+                x = out_buf.pop().args[1]
+            out_buf.extend(self._expansion(instr_by_tag[asm_stmt.args[0]], x))
+        return out_buf
+
+    def _expansion(self, instr, x=SCR0):
+        ## returns list(AsmStatement), in-line expansion of emulated instruction
+        asm_out = AsmBuffer()
+        getattr(self, f'_compile_{instr}_definition')(asm_out, x)
+        end_tag = AsmTag()
+        stmt_buf = []
+        for asm_stmt in asm_out.stmt_buf:
+            if isinstance(asm_stmt, AsmCmd) and asm_stmt.instr == 'RET':
+                stmt_buf.append(AsmBuffer.new_statement('JMP', end_tag))
+            else:
+                stmt_buf.append(asm_stmt)
+        stmt_buf.append(end_tag)
+        stmt_buf[0].comment = instr
+        return stmt_buf
+
+    def _expansion_cost(self, instr):
+        ## returns tuple(int n_stmts, int n_tags), growth of an in-line expansion replacing a CALL
+        stmt_buf = self._expansion(instr)
+        n_tags = sum(1 for asm_stmt in stmt_buf if isinstance(asm_stmt, AsmTag))
+        return len(stmt_buf) - n_tags - 1, n_tags
+
+    @staticmethod
+    def _loop_depth(stmt_buf):
+        ## returns list(int), number of backward jumps enclosing each statement
+        tag_pos = {asm_stmt: i_stmt for i_stmt, asm_stmt in enumerate(stmt_buf) if isinstance(asm_stmt, AsmTag)}
+        loop_depth = [0] * len(stmt_buf)
+        for i_stmt, asm_stmt in enumerate(stmt_buf):
+            if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr != 'CALL':
+                i_target = tag_pos.get(asm_stmt.args[0], i_stmt)
+                for i_loop in range(i_target, i_stmt):
+                    loop_depth[i_loop] += 1
+        return loop_depth
+
     def compile(self, cc, instr):       ## A := instr(A); F := undef
         if instr not in self.instr_funcs:
             if instr in self.INLINED_INSTR:
@@ -252,7 +1138,7 @@ class EmulatedInstrs:
     def _compile_NOT_inline(self, asm_out):
         asm_out('XOR', '0xffffffff')    ## A := A ^ 0xffffffff; F := A
 
-    def _compile_NOTL_definition(self, asm_out):
+    def _compile_NOTL_definition(self, asm_out, x=SCR0):
         true_tag = AsmTag()
         asm_out('OR', 0, comment='F=A') ## assert F := A before conditional jump
         asm_out('JZ', true_tag)         ## IF (F == 0) GOTO true_tag
@@ -261,45 +1147,45 @@ class EmulatedInstrs:
         asm_out('TAG', true_tag)        ## true_tag: return TRUE
         asm_out('LDA', 1)
 
-    def _compile_ANDL_definition(self, asm_out):
+    def _compile_ANDL_definition(self, asm_out, x=SCR0):
         ret_tag = AsmTag()
         asm_out('OR', 0, comment='F=A') ## assert F := A before conditional jump
         asm_out('JZ', ret_tag)          ## IF (F == 0) GOTO ret_tag
-        asm_out('LDA', SCR0)
+        asm_out('LDA', x)
         asm_out('OR', 0, comment='F=A') ## assert F := A before conditional jump
         asm_out('JZ', ret_tag)          ## IF (F == 0) GOTO ret_tag
         asm_out('LDA', 1)
         asm_out('TAG', ret_tag)         ## ret_tag: return TRUE or FALSE
 
-    def _compile_ORL_definition(self, asm_out):
+    def _compile_ORL_definition(self, asm_out, x=SCR0):
         true_tag = AsmTag()
-        asm_out('OR', SCR0)             ## A := A | SCR0, F := A
+        asm_out('OR', x)                ## A := A | x, F := A
         asm_out('JNZ', true_tag)        ## IF (F != 0) GOTO true_tag
         asm_out('RET')                  ## return FALSE
         asm_out('TAG', true_tag)        ## true_tag: return TRUE
         asm_out('LDA', 1)
 
-    def _compile_EQ_definition(self, asm_out):
+    def _compile_EQ_definition(self, asm_out, x=SCR0):
         true_tag = AsmTag()
-        asm_out('CMP', SCR0)            ## F := A - SCR0
+        asm_out('CMP', x)               ## F := A - x
         asm_out('JZ', true_tag)         ## IF (F == 0) GOTO true_tag
         asm_out('LDA', 0)
         asm_out('RET')                  ## return FALSE
         asm_out('TAG', true_tag)        ## true_tag: return TRUE
         asm_out('LDA', 1)
 
-    def _compile_NE_definition(self, asm_out):
+    def _compile_NE_definition(self, asm_out, x=SCR0):
         true_tag = AsmTag()
-        asm_out('CMP', SCR0)            ## F := A - SCR0
+        asm_out('CMP', x)               ## F := A - x
         asm_out('JNZ', true_tag)        ## IF (F != 0) GOTO true_tag
         asm_out('LDA', 0)               ## A := 0
         asm_out('RET')                  ## return FALSE
         asm_out('TAG', true_tag)        ## true_tag: return TRUE
         asm_out('LDA', 1)
 
-    def _compile_GT_definition(self, asm_out):
+    def _compile_GT_definition(self, asm_out, x=SCR0):
         false_tag = AsmTag()
-        asm_out('CMP', SCR0)            ## F := A - SCR0
+        asm_out('CMP', x)               ## F := A - x
         asm_out('JZ', false_tag)        ## IF (F == 0) GOTO false_tag
         asm_out('JM', false_tag)        ## IF (F < 0) GOTO false_tag
         asm_out('LDA', 1)
@@ -307,27 +1193,27 @@ class EmulatedInstrs:
         asm_out('TAG', false_tag)       ## false_tag: return FALSE
         asm_out('LDA', 0)
 
-    def _compile_GE_definition(self, asm_out):
+    def _compile_GE_definition(self, asm_out, x=SCR0):
         true_tag = AsmTag()
-        asm_out('CMP', SCR0)            ## F := A - SCR0
+        asm_out('CMP', x)               ## F := A - x
         asm_out('JP',  true_tag)        ## IF (F >= 0) GOTO true_tag
         asm_out('LDA', 0)
         asm_out('RET')                  ## return FALSE
         asm_out('TAG', true_tag)        ## true_tag: return TRUE
         asm_out('LDA', 1)
 
-    def _compile_LT_definition(self, asm_out):
+    def _compile_LT_definition(self, asm_out, x=SCR0):
         true_tag = AsmTag()
-        asm_out('CMP', SCR0)            ## F := A - SCR0
+        asm_out('CMP', x)               ## F := A - x
         asm_out('JM',  true_tag)        ## IF (F < 0) GOTO true_tag
         asm_out('LDA', 0)
         asm_out('RET')                  ## return FALSE
         asm_out('TAG', true_tag)        ## true_tag: return TRUE
         asm_out('LDA', 1)
 
-    def _compile_LE_definition(self, asm_out):
+    def _compile_LE_definition(self, asm_out, x=SCR0):
         true_tag = AsmTag()
-        asm_out('CMP', SCR0)            ## F := A - SCR0
+        asm_out('CMP', x)               ## F := A - x
         asm_out('JZ', true_tag)         ## IF (F == 0) GOTO true_tag
         asm_out('JM', true_tag)         ## IF (F < 0) GOTO true_tag
         asm_out('LDA', 0)
@@ -400,7 +1286,12 @@ class UserDefFunction(Function):
         self.asm_buf = AsmBuffer()      ## AsmBuffer, function implementation's statement buffer
         self.arg_vars = [               ## list(AsmVar), function argument VM variables
             AsmVar() for i in range(self.arg_count)]
+        ## list(AsmVar), argument variables read by a CALL, callers need not store arguments passed in A
+        ## (see AccumulatorArgPasser) or never read (see AsmDeadCodeEliminator)
+        self.passed_arg_vars = list(self.arg_vars)
         self.static_asm_tags = {}       ## dict(str tag_label: AsmTag asm_tag), user-defined static tags
+        self.temp_vars = []             ## list(AsmVar), compiler temporaries holding operands, by nesting depth
+        self.is_inline = False          ## bool, True: function declared "inline"
 
     def asm_repr(self):
         return self.asm_tag
@@ -466,6 +1357,11 @@ class VmApiFunction(Function):
         'gpioSetMode':                  'MI',       ## EIS: normal prototype MI x1 x2
         'gpioSetPullUpDown':            'PUDI' }    ## EIS: normal prototype PUDI x1 x2
 
+    ## functions and asm() instructions that change the mode of a GPIO or switch PWM or servo pulses on,
+    ## unlike gpioWrite() (WRITE), which makes the GPIO an output, BS1/BC1 and BS2/BC2 only set levels
+    GPIO_MODE_FUNCTIONS = ('gpioSetMode', 'gpioPWM', 'gpioServo', 'gpioHardwareClock', 'gpioHardwarePWM')
+    GPIO_MODE_INSTR = ('MODES', 'M', 'MI', 'PWM', 'P', 'SERVO', 'S', 'HC', 'HP')
+
     def __init__(self, decl_node, prototype, use_cis):
         super().__init__(decl_node, prototype)
         self.use_cis = use_cis
@@ -484,6 +1380,33 @@ class VmApiFunction(Function):
                 self.instr = self.VM_FUNCTION_INSTR_CIS[func_name]
         return self.instr
 
+    @classmethod
+    def find_output_gpios(cls, node, folder):
+        ## returns set(int), GPIOs which the program node (folded by AstConstantFolder folder) sets to output
+        ## mode and never to another mode, PWM or servo pulses, empty if any call has a non-constant GPIO
+        gpio_modes = {}                     ## dict(int gpio: set(None or int mode)), modes set, None: PWM/servo
+        for call_node in cls._find_calls(node):
+            func_name = call_node.name.name
+            args = call_node.args.exprs if call_node.args is not None else []
+            if func_name == 'asm':
+                if len(args) > 0 and isinstance(args[0], c_ast.Constant) and args[0].type == 'string' and \
+                        args[0].value[1:-1].upper() in cls.GPIO_MODE_INSTR:
+                    return set()
+            elif func_name in cls.GPIO_MODE_FUNCTIONS and len(args) > 0:
+                gpio = folder.eval_expression(args[0])
+                mode = folder.eval_expression(args[1]) if func_name == 'gpioSetMode' and len(args) > 1 else None
+                if gpio is None or (func_name == 'gpioSetMode' and mode is None):
+                    return set()
+                gpio_modes.setdefault(gpio, set()).add(mode)
+        return {gpio for gpio, modes in gpio_modes.items() if modes == {1}}    ## PI_OUTPUT
+
+    @classmethod
+    def _find_calls(cls, node):
+        if isinstance(node, c_ast.FuncCall) and isinstance(node.name, c_ast.ID):
+            yield node
+        for child_name, child_node in node.children():
+            yield from cls._find_calls(child_node)
+
     def _map_argument_cis_gpioSetMode(self, node, i_arg, const_arg):
         if i_arg == 1:
             ## int gpioSetMode(unsigned gpio, unsigned mode), 2nd argument "mode":
@@ -512,6 +1435,242 @@ class VmApiFunction(Function):
 
 ## ---------------------------------------------------------------------------
 
+class FunctionInliner:
+    ## instructions whose variable argument at the given index may be replaced by a constant or parameter
+    OPERAND_INSTR_IDX = {'LDA': 0, 'ADD': 0, 'SUB': 0, 'MLT': 0, 'DIV': 0, 'MOD': 0, 'AND': 0, 'OR': 0,
+        'XOR': 0, 'RLA': 0, 'RRA': 0, 'CMP': 0, 'LD': 1}
+
+    def __init__(self, opt_level, profile=None):
+        self.opt_level = opt_level          ## str, optimization level "0", "1", "2" or "s"
+        self.profile = profile              ## None or PccProfile, execution counts of a profiling run
+        self.inline_count = 0               ## int, number of in-line expanded calls
+
+    def inline(self, functions, em_instrs):
+        ## expand CALLs of small user-defined functions (or those declared "inline") in-line, callees
+        ## first, functions no longer called afterwards get dropped by the caller's usual mechanism
+        ## functions: list(UserDefFunction), main() and user-defined functions with implementation
+        if self.opt_level == '0':
+            return
+        func_by_tag = {function.asm_tag: function for function in functions}
+        func_by_name = {function.func_name: function for function in functions}
+        helper_by_tag = {} if em_instrs is None else \
+            {instr_func.asm_tag: instr_func for instr_func in em_instrs.instr_funcs.values()}
+        tag_count = sum(len(self._body_tags(function)) + 1 for function in functions) + \
+            sum(len(self._body_tags(instr_func)) + 1 for instr_func in helper_by_tag.values())
+        for callee in self._callees_first(functions, func_by_tag):
+            if callee.func_name == 'main':
+                continue
+            call_sites = [(caller, asm_stmt) for caller in functions for asm_stmt in caller.asm_buf.stmt_buf
+                if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'CALL' and asm_stmt.args[0] is callee.asm_tag]
+            if len(call_sites) == 0 or not self._is_worthwhile(callee, len(call_sites)):
+                continue
+            n_body_tags = len(self._body_tags(callee))
+            tag_growth = len(call_sites) * (n_body_tags + 1) - n_body_tags - 1
+            if tag_count + tag_growth > VM_MAX_TAGS:
+                continue
+            tag_count += tag_growth
+            for caller in set(caller for caller, asm_stmt in call_sites):
+                caller.asm_buf.stmt_buf = self._expand_calls(caller.asm_buf.stmt_buf, callee)
+                callee.caller.discard(caller.func_name)
+                ## functions called by callee are now called by caller, too
+                for asm_stmt in callee.asm_buf.stmt_buf:
+                    if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'CALL':
+                        if asm_stmt.args[0] in func_by_tag:
+                            func_by_tag[asm_stmt.args[0]].caller.add(caller.func_name)
+                        elif asm_stmt.args[0] in helper_by_tag:
+                            helper_by_tag[asm_stmt.args[0]].caller.add(caller.func_name)
+
+    ## Private functions
+
+    def _is_worthwhile(self, callee, n_sites):
+        n_stmts = sum(1 for asm_stmt in callee.asm_buf.stmt_buf
+            if isinstance(asm_stmt, AsmCmd) and asm_stmt.instr != 'RET')
+        if callee.is_inline or n_sites == 1:
+            return True
+        elif self.opt_level == 's':         ## n_sites * (CALL) + body + RET
+            return n_sites * n_stmts <= n_sites + n_stmts + 1
+        max_stmts = INLINE_MAX_FUNC_SIZE if self.opt_level == '1' else 2 * INLINE_MAX_FUNC_SIZE
+        ## profiled functions: never called ones stay out of line, hot ones may be twice as large
+        call_count = self.profile.func_count(callee.func_name) if self.profile is not None else None
+        if call_count == 0:
+            return False
+        elif call_count is not None and call_count >= PROFILE_HOT_COUNT:
+            max_stmts *= 2
+        return n_stmts <= max_stmts
+
+    @staticmethod
+    def _body_tags(function):
+        ## returns set(AsmTag), tags defined within function body (excluding its entry point)
+        return set(asm_stmt for asm_stmt in function.asm_buf.stmt_buf
+            if isinstance(asm_stmt, AsmTag) and asm_stmt is not function.asm_tag)
+
+    @staticmethod
+    def _callees_first(functions, func_by_tag):
+        ## returns list(UserDefFunction) in bottom-up call graph order, functions on call cycles are omitted
+        callees = {function: set(func_by_tag[asm_stmt.args[0]] for asm_stmt in function.asm_buf.stmt_buf
+            if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'CALL' and asm_stmt.args[0] in func_by_tag)
+            for function in functions}
+        ordered = []
+        pending = list(functions)
+        changed = True
+        while changed:
+            changed = False
+            for function in list(pending):
+                if all(callee in ordered for callee in callees[function]):
+                    ordered.append(function)
+                    pending.remove(function)
+                    changed = True
+        return ordered
+
+    def _expand_calls(self, stmt_buf, callee):
+        out_buf = []
+        for asm_stmt in stmt_buf:
+            if not (isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'CALL' and asm_stmt.args[0] is callee.asm_tag):
+                out_buf.append(asm_stmt)
+                continue
+            ## "LD arg_var x + ... + CALL callee" => use x directly where possible
+            arg_terms = {}
+            i_load = len(out_buf)
+            kept_loads = []
+            while i_load > 0 and isinstance(out_buf[i_load - 1], AsmCmd) and out_buf[i_load - 1].instr == 'LD' and \
+                    out_buf[i_load - 1].args[0] in callee.arg_vars and out_buf[i_load - 1].args[0] not in arg_terms:
+                i_load -= 1
+                arg_var, arg_term = out_buf[i_load].args
+                if self._is_substitutable(callee, arg_var, arg_term):
+                    arg_terms[arg_var] = arg_term
+                else:
+                    kept_loads.insert(0, out_buf[i_load])
+                    arg_terms[arg_var] = arg_var
+            out_buf[i_load:] = kept_loads
+            out_buf.extend(self._expansion(callee, arg_terms, asm_stmt.comment))
+            self.inline_count += 1
+        return out_buf
+
+    def _is_substitutable(self, callee, arg_var, arg_term):
+        ## arg_var must only be read by operand instructions, a variable arg_term must not change within callee
+        is_const = not isinstance(arg_term, AsmVar) and re.fullmatch(r'p[0-9]', str(arg_term)) is None
+        for asm_stmt in callee.asm_buf.stmt_buf:
+            if not isinstance(asm_stmt, AsmCmd):
+                continue
+            if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'CALL' and not is_const:
+                return False
+            read_vars, written_vars = asm_stmt.var_access()
+            if arg_var in written_vars or (arg_term in written_vars) or \
+                    (not is_const and asm_stmt.instr in ('POP', 'X', 'XA') and arg_term in asm_stmt.args):
+                return False
+            for i_arg, arg in enumerate(asm_stmt.args):
+                if arg is arg_var and self.OPERAND_INSTR_IDX.get(asm_stmt.instr, -1) != i_arg:
+                    return False
+        return True
+
+    def _expansion(self, callee, arg_terms, comment):
+        ## returns list(AsmStatement), copy of callee's body with its own tags cloned
+        tag_map = {asm_tag: AsmTag() for asm_tag in self._body_tags(callee)}
+        end_tag = AsmTag()
+        stmt_buf = []
+        for asm_stmt in callee.asm_buf.stmt_buf:
+            if asm_stmt is callee.asm_tag:
+                continue
+            elif isinstance(asm_stmt, AsmTag):
+                stmt_buf.append(tag_map[asm_stmt])
+            elif asm_stmt.instr == 'RET':
+                stmt_buf.append(AsmBuffer.new_statement('JMP', end_tag))
+            elif isinstance(asm_stmt, AsmBranchCmd):
+                stmt_buf.append(AsmBranchCmd(asm_stmt.instr, [tag_map.get(asm_stmt.args[0], asm_stmt.args[0])], asm_stmt.comment))
+            else:
+                args = [arg_terms.get(arg, arg) if isinstance(arg, AsmVar) else arg for arg in asm_stmt.args]
+                stmt_buf.append(self._reduced_cmd(asm_stmt.instr, args, asm_stmt.comment))
+            if isinstance(asm_stmt, AsmCmd):
+                stmt_buf[-1].coord = asm_stmt.coord
+        stmt_buf.append(end_tag)
+        if len(stmt_buf) > 0 and isinstance(stmt_buf[0], AsmCmd):
+            stmt_buf[0].comment = f'{comment} (in-line)' if comment is not None else None
+        return stmt_buf
+
+    @staticmethod
+    def _reduced_cmd(instr, args, comment):
+        ## returns AsmCmd, "MLT 2^k" with a substituted constant argument becomes "RLA k"
+        if instr == 'MLT' and not isinstance(args[0], AsmVar) and re.fullmatch(r'(0x[0-9a-fA-F]+|\d+)', str(args[0])):
+            value = int(str(args[0]), 0)
+            if value > 1 and value & (value - 1) == 0:
+                return AsmCmd('RLA', [str(value.bit_length() - 1)], comment)
+        return AsmCmd(instr, args, comment)
+
+## ---------------------------------------------------------------------------
+
+class AccumulatorArgPasser:
+    ## calling convention: a user-defined function whose body starts by loading its first argument
+    ## ("LDA arg0") takes it in A if every call site assigns it last, followed only by loads of other
+    ## arguments ("LD arg1 x"): the caller's "STA arg0" is dropped ("LD arg0 x" becomes "LDA x") and the
+    ## callee's "LDA arg0" becomes "STA arg0", which AsmDeadCodeEliminator drops if the callee never
+    ## reads the argument again
+    def __init__(self):
+        self.function_count = 0             ## int, number of functions taking their first argument in A
+
+    def apply(self, functions, asm_bufs):
+        ## returns list(AsmBuffer), modified buffers
+        ## functions: list(UserDefFunction), called user-defined functions, asm_bufs: list(AsmBuffer), all
+        ## buffers calling them
+        modified_bufs = []
+        for callee in functions:
+            call_sites = self._call_sites(callee, asm_bufs)
+            if call_sites is None:
+                continue
+            for asm_buf, i_store in reversed(call_sites):   ## back to front, dropped stores shift statements
+                store_cmd = asm_buf.stmt_buf[i_store]
+                if store_cmd.instr == 'STA':
+                    del asm_buf.stmt_buf[i_store]
+                else:
+                    load_cmd = AsmCmd('LDA', store_cmd.args[1:], store_cmd.comment)
+                    load_cmd.coord = store_cmd.coord
+                    asm_buf.stmt_buf[i_store] = load_cmd
+                if asm_buf not in modified_bufs:
+                    modified_bufs.append(asm_buf)
+            entry_cmd = callee.asm_buf.stmt_buf[1]
+            callee.asm_buf.stmt_buf[1] = AsmCmd('STA', entry_cmd.args, entry_cmd.comment)
+            callee.asm_buf.stmt_buf[1].coord = entry_cmd.coord
+            callee.passed_arg_vars = [asm_var for asm_var in callee.passed_arg_vars if asm_var is not callee.arg_vars[0]]
+            if callee.asm_buf not in modified_bufs:
+                modified_bufs.append(callee.asm_buf)
+            self.function_count += 1
+        return modified_bufs
+
+    ## Private functions
+
+    @staticmethod
+    def _call_sites(callee, asm_bufs):
+        ## returns None (convention not applicable) or list(tuple(AsmBuffer asm_buf, int i_store)), position
+        ## of the "STA arg0" or "LD arg0 x" in front of each CALL of callee
+        stmt_buf = callee.asm_buf.stmt_buf
+        if callee.arg_count == 0 or len(stmt_buf) < 2 or stmt_buf[0] is not callee.asm_tag or \
+                not isinstance(stmt_buf[1], AsmCmd) or stmt_buf[1].instr != 'LDA' or \
+                stmt_buf[1].args[0] is not callee.arg_vars[0]:
+            return None
+        call_sites = []
+        for asm_buf in asm_bufs:
+            for i_stmt, asm_stmt in enumerate(asm_buf.stmt_buf):
+                if not isinstance(asm_stmt, AsmBranchCmd) or asm_stmt.args[0] is not callee.asm_tag:
+                    continue
+                if asm_stmt.instr != 'CALL':
+                    return None
+                ## skip loads of the other arguments which don't read the first one
+                i_store = i_stmt - 1
+                while i_store >= 0 and AccumulatorArgPasser._is_other_arg_load(callee, asm_buf.stmt_buf[i_store]):
+                    i_store -= 1
+                store_cmd = asm_buf.stmt_buf[i_store] if i_store >= 0 else None
+                if not isinstance(store_cmd, AsmCmd) or store_cmd.instr not in ('STA', 'LD') or \
+                        store_cmd.args[0] is not callee.arg_vars[0]:
+                    return None
+                call_sites.append((asm_buf, i_store))
+        return call_sites
+
+    @staticmethod
+    def _is_other_arg_load(callee, asm_stmt):
+        return isinstance(asm_stmt, AsmCmd) and asm_stmt.instr == 'LD' and \
+               asm_stmt.args[0] in callee.arg_vars[1:] and asm_stmt.args[1] is not callee.arg_vars[0]
+
+## ---------------------------------------------------------------------------
+
 class AbstractSymbol:
     def __init__(self, cname):
         self.cname = cname              ## str cname, symbol's C name in scope
@@ -609,12 +1768,556 @@ class PccLogger:
                     self.e_location = e_location
                     error_msg = f'{filename}: In function "{ctx_func_name}":\n'
             src_line = self.c_sources.line_at(filename, row)
-            pointer_indent = self.NON_WHITESPACE_PATTERN.sub(src_line[:col-1])
+            pointer_indent = self.NON_WHITESPACE_PATTERN.sub(' ', src_line[:col-1])
             error_msg += f'{filename}:{row}:{col}: {message}\n{src_line}\n{pointer_indent}^^^'
         print(error_msg, file=self.file)
 
 ## ---------------------------------------------------------------------------
 
+class AstConstantFolder:
+    class VarInfo:
+        def __init__(self, decl_node, is_extern):
+            self.decl_node = decl_node      ## c_ast.Decl, variable declaration
+            self.is_extern = is_extern      ## bool, True: VM parameter (extern) or function argument
+            self.is_written = False         ## bool, True: assigned outside of its declaration
+            self.const_value = None         ## None or int, propagated constant value
+            self.is_resolved = False        ## bool, True: const_value has been determined
+
+    OPAQUE = object()                       ## scope marker of names without constant value (functions, ...)
+
+    def __init__(self, global_names=None):
+        self.scope = collections.ChainMap() ## ChainMap, current scope, maps C name to int (enum), VarInfo or OPAQUE
+        if global_names is not None:
+            self.scope.maps[0].update(global_names)
+        self.id_refs = {}                   ## dict(c_ast.ID node: int or VarInfo), resolved identifier references
+        self.var_infos = []                 ## list(VarInfo), all variables in declaration order
+        self.fold_count = 0                 ## int, number of folded expressions
+
+    def fold(self, ast_root_node):
+        ## resolve identifiers and find variables that are only ever assigned in their declaration
+        self._resolve(ast_root_node)
+        for var_info in self.var_infos:
+            self._resolve_var(var_info)
+        ## replace constant sub-expressions and propagated variables with int constants
+        self._rewrite(ast_root_node)
+        for var_info in self.var_infos:
+            if var_info.const_value is not None:
+                var_info.decl_node.init = None
+        return self.fold_count
+
+    @staticmethod
+    def parse_int(value):
+        ## returns int, value of C integer literal str value (decimal, octal or hexadecimal)
+        value = value.rstrip('uUlL')
+        if len(value) > 1 and value[0] == '0' and value[1] not in 'xX':
+            return int(value, 8)
+        return int(value, 0)
+
+    @staticmethod
+    def int32(value):
+        ## returns int, value truncated to 32 bit signed integer (VM semantics)
+        value &= 0xffffffff
+        return value - 0x100000000 if value & 0x80000000 else value
+
+    @classmethod
+    def eval_unary_op(cls, op, a):
+        if op == '+':
+            return a
+        elif op == '-':
+            return cls.int32(-a)
+        elif op == '~':
+            return cls.int32(~a)
+        elif op == '!':
+            return int(a == 0)
+        return None
+
+    @classmethod
+    def eval_binary_op(cls, op, a, b):
+        ## returns None or int, result of a <op> b, None if not evaluable at compile-time
+        if op in ('/', '%'):
+            if b == 0 or (a == -0x80000000 and b == -1):
+                return None
+            q = abs(a) // abs(b)
+            if (a < 0) != (b < 0):
+                q = -q
+            return q if op == '/' else a - q * b
+        elif op in ('<<', '>>'):
+            if b < 0 or b > 31:
+                return None
+            return cls.int32(a << b) if op == '<<' else a >> b
+        result = {
+            '+':  lambda: a + b,  '-':  lambda: a - b,  '*':  lambda: a * b,
+            '&':  lambda: a & b,  '|':  lambda: a | b,  '^':  lambda: a ^ b,
+            '&&': lambda: int(a != 0 and b != 0),       '||': lambda: int(a != 0 or b != 0),
+            '==': lambda: int(a == b), '!=': lambda: int(a != b),
+            '>':  lambda: int(a > b),  '>=': lambda: int(a >= b),
+            '<':  lambda: int(a < b),  '<=': lambda: int(a <= b) }.get(op, None)
+        return cls.int32(result()) if result is not None else None
+
+    def eval_expression(self, node):
+        ## returns None or int, constant value of expression node
+        if isinstance(node, c_ast.Constant):
+            if node.type == 'int':
+                try:
+                    return self.int32(self.parse_int(node.value))
+                except ValueError:
+                    pass
+        elif isinstance(node, c_ast.ID):
+            ref = self.id_refs.get(node, None)
+            if isinstance(ref, int):
+                return ref
+            elif isinstance(ref, self.VarInfo):
+                return self._resolve_var(ref)
+        elif isinstance(node, c_ast.UnaryOp):
+            a = self.eval_expression(node.expr)
+            if a is not None:
+                return self.eval_unary_op(node.op, a)
+        elif isinstance(node, c_ast.BinaryOp):
+            a = self.eval_expression(node.left)
+            if a is not None:
+                b = self.eval_expression(node.right)
+                if b is not None:
+                    return self.eval_binary_op(node.op, a, b)
+        return None
+
+    ## Private functions
+
+    def _resolve_var(self, var_info):
+        if not var_info.is_resolved:
+            var_info.is_resolved = True     ## guards against self-referencing initializers
+            init_node = var_info.decl_node.init
+            if not var_info.is_extern and not var_info.is_written and init_node is not None:
+                var_info.const_value = self.eval_expression(init_node)
+        return var_info.const_value
+
+    def _bind(self, cname, ref):
+        self.scope.maps[0][cname] = ref
+
+    def _mark_written(self, node):
+        if isinstance(node, c_ast.ID):
+            ref = self.scope.get(node.name, None)
+            if isinstance(ref, self.VarInfo):
+                ref.is_written = True
+
+    def _resolve(self, node):
+        if node is None:
+            return
+        elif isinstance(node, (c_ast.Compound, c_ast.For)):
+            self.scope = self.scope.new_child()
+            try:
+                self._resolve_children(node)
+            finally:
+                self.scope = self.scope.parents
+        elif isinstance(node, c_ast.FuncDef):
+            self._bind(node.decl.name, self.OPAQUE)
+            self.scope = self.scope.new_child()
+            try:
+                func_args = node.decl.type.args
+                if func_args is not None:
+                    for arg_node in func_args.params:
+                        if isinstance(arg_node, c_ast.Decl) and arg_node.name is not None:
+                            self._bind(arg_node.name, self.VarInfo(arg_node, True))
+                self._resolve(node.body)
+            finally:
+                self.scope = self.scope.parents
+        elif isinstance(node, c_ast.Decl):
+            if isinstance(node.type, c_ast.FuncDecl):
+                self._bind(node.name, self.OPAQUE)
+                return
+            self._resolve(node.type)
+            if node.name is not None:
+                var_info = self.VarInfo(node, 'extern' in node.storage)
+                self.var_infos.append(var_info)
+                self._bind(node.name, var_info)
+            self._resolve(node.init)
+        elif isinstance(node, c_ast.Enum):
+            if node.values is not None:
+                enum_cursor = 0
+                for enum_node in node.values.enumerators:
+                    if enum_node.value is not None and enum_cursor is not None:
+                        self._resolve(enum_node.value)
+                        enum_cursor = self.eval_expression(enum_node.value)
+                    if enum_cursor is None:
+                        self._bind(enum_node.name, self.OPAQUE)
+                    else:
+                        self._bind(enum_node.name, enum_cursor)
+                        enum_cursor += 1
+        elif isinstance(node, c_ast.ID):
+            ref = self.scope.get(node.name, None)
+            if ref is not None and ref is not self.OPAQUE:
+                self.id_refs[node] = ref
+        elif isinstance(node, c_ast.Assignment):
+            self._mark_written(node.lvalue)
+            self._resolve(node.rvalue)
+        elif isinstance(node, c_ast.UnaryOp) and node.op in ('++', '--', 'p++', 'p--'):
+            self._mark_written(node.expr)
+        elif isinstance(node, c_ast.FuncCall):
+            if node.args is not None:
+                if isinstance(node.name, c_ast.ID) and node.name.name == 'asm':
+                    ## asm() statements may write any variable they reference
+                    for arg_node in node.args.exprs:
+                        self._mark_written(arg_node)
+                self._resolve(node.args)
+        else:
+            self._resolve_children(node)
+
+    def _resolve_children(self, node):
+        for child_name, child_node in node.children():
+            self._resolve(child_node)
+
+    def _rewrite(self, node):
+        for child_name, child_node in node.children():
+            if isinstance(child_node, (c_ast.UnaryOp, c_ast.BinaryOp, c_ast.ID)) and \
+                    not (isinstance(node, c_ast.FuncCall) and child_name == 'name'):
+                const_value = self.eval_expression(child_node)
+                if const_value is not None and not (isinstance(child_node, c_ast.ID) and
+                        isinstance(self.id_refs.get(child_node, None), int)):
+                    ## replace constant sub-expression (or propagated variable) with int constant
+                    const_node = c_ast.Constant('int', str(const_value), coord=child_node.coord)
+                    self._replace_child(node, child_name, const_node)
+                    self.fold_count += 1
+                    continue
+            self._rewrite(child_node)
+
+    @staticmethod
+    def _replace_child(node, child_name, new_child):
+        m = re.fullmatch(r'(\w+)\[(\d+)\]', child_name)
+        if m is None:
+            setattr(node, child_name, new_child)
+        else:
+            getattr(node, m[1])[int(m[2])] = new_child
+
+## ---------------------------------------------------------------------------
+
+class AstFunctionEvaluator:
+    ## compile-time evaluation of calls of pure user-defined functions with constant arguments: a function
+    ## is pure if it only accesses its arguments and local variables and calls no VM API function, asm()
+    ## or impure function, its locals must not be read before they are assigned, since local variables
+    ## keep their values from call to call, recursive calls are left to the VM, they share these variables
+    class NotEvaluable(Exception):      ## call can only be evaluated at run-time
+        pass
+
+    class Return(Exception):
+        def __init__(self, value):
+            super().__init__()
+            self.value = value          ## None or int, returned value
+
+    class Break(Exception):
+        pass
+
+    class Continue(Exception):
+        pass
+
+    STATEMENT_CHILDREN = {              ## dict(class: tuple(str child_name)), children in statement position
+        c_ast.If: ('iftrue', 'iffalse'), c_ast.While: ('stmt',), c_ast.DoWhile: ('stmt',),
+        c_ast.For: ('init', 'stmt') }
+
+    def __init__(self, global_names):
+        self.global_names = global_names    ## dict(str cname: int or other), int: enum constant of the global scope
+        self.func_defs = {}                 ## dict(str func_name: c_ast.FuncDef), user-defined functions
+        self.pure_funcs = {}                ## dict(str func_name: bool), functions checked for purity
+        self.results = {}                   ## dict(tuple(str func_name, tuple(int) arg_values): None or int)
+        self.active_funcs = set()           ## set(str func_name), functions of the calls being evaluated
+        self.step_count = 0                 ## int, statements and expressions evaluated for the current call
+        self.eval_count = 0                 ## int, number of calls replaced by their value
+        self._locals_declared = set()       ## set(str cname), local variables in scope during the purity check
+        self._switch_assigned = None        ## None or set(str cname), definitely assigned variables at the switch
+
+    def declare(self, ast_root_node):
+        for node in ast_root_node.ext:
+            if isinstance(node, c_ast.FuncDef):
+                self.func_defs[node.decl.name] = node
+
+    def evaluate_calls(self, node):
+        ## replace calls in node by their value, statement calls by empty statements
+        ## returns int, number of replaced calls
+        eval_count = self.eval_count
+        self._rewrite(node)
+        return self.eval_count - eval_count
+
+    ## Private functions
+
+    def _rewrite(self, node):
+        for child_name, child_node in node.children():
+            self._rewrite(child_node)
+            if not isinstance(child_node, c_ast.FuncCall) or not isinstance(child_node.name, c_ast.ID):
+                continue
+            arg_nodes = child_node.args.exprs if child_node.args is not None else []
+            if not all(isinstance(arg_node, c_ast.Constant) and arg_node.type == 'int' for arg_node in arg_nodes):
+                continue
+            key = (child_node.name.name, tuple(AstConstantFolder.int32(AstConstantFolder.parse_int(arg_node.value))
+                for arg_node in arg_nodes))
+            if key not in self.results:
+                self.step_count = 0
+                try:
+                    self.results[key] = self._call(key[0], key[1], 0)
+                except self.NotEvaluable:
+                    self.results[key] = self.NotEvaluable
+            value = self.results[key]
+            if value is self.NotEvaluable:
+                continue
+            is_statement = isinstance(node, (c_ast.Compound, c_ast.Case, c_ast.Default)) or \
+                child_name in self.STATEMENT_CHILDREN.get(type(node), ())
+            if is_statement:
+                new_node = c_ast.EmptyStatement(coord=child_node.coord)
+            elif value is not None:
+                new_node = c_ast.Constant('int', str(value), coord=child_node.coord)
+            else:
+                continue                    ## value of a void function, the compiler reports it
+            AstConstantFolder._replace_child(node, child_name, new_node)
+            self.eval_count += 1
+
+    def _call(self, func_name, arg_values, depth):
+        ## returns None or int, returned value
+        func_def = self.func_defs.get(func_name, None)
+        if func_def is None or depth == EVAL_MAX_CALL_DEPTH or func_name in self.active_funcs or \
+                not self._is_pure(func_name):
+            raise self.NotEvaluable()
+        params = func_def.decl.type.args.params if func_def.decl.type.args is not None else []
+        arg_names = [param.name for param in params if not isinstance(param, c_ast.Typename)]
+        if len(arg_names) != len(arg_values):
+            raise self.NotEvaluable()
+        env = collections.ChainMap(dict(zip(arg_names, arg_values)))
+        self.active_funcs.add(func_name)
+        try:
+            self._exec(func_def.body, env, depth)
+        except self.Return as r:
+            return r.value
+        except (self.Break, self.Continue):
+            raise self.NotEvaluable()
+        finally:
+            self.active_funcs.discard(func_name)
+        if func_def.decl.type.type.type.names != ['void']:
+            raise self.NotEvaluable()       ## no return value, the compiler warns about it
+        return None
+
+    def _is_pure(self, func_name):
+        if func_name not in self.pure_funcs:
+            self.pure_funcs[func_name] = False  ## guards against recursion
+            func_def = self.func_defs[func_name]
+            params = func_def.decl.type.args.params if func_def.decl.type.args is not None else []
+            arg_names = set(param.name for param in params if not isinstance(param, c_ast.Typename))
+            self._locals_declared = set(arg_names)
+            try:
+                self._assigned_after(func_def.body, arg_names)
+                self.pure_funcs[func_name] = True
+            except self.NotEvaluable:
+                pass
+        return self.pure_funcs[func_name]
+
+    def _assigned_after(self, node, assigned):
+        ## returns None or set(str cname), variables definitely assigned after statement or expression node
+        ## given the definitely assigned variables in front of it, None if node does not complete (return,
+        ## break, continue), raises NotEvaluable if node may read a local variable before it is assigned
+        ## (variables not declared in the function are globals, their accesses fail at evaluation)
+        if assigned is None and not isinstance(node, (c_ast.Case, c_ast.Default)):
+            return None
+        if isinstance(node, c_ast.ID):
+            if node.name in self._locals_declared and node.name not in assigned:
+                raise self.NotEvaluable()
+            return assigned
+        elif isinstance(node, c_ast.Decl):
+            assigned = self._assigned_after(node.init, assigned) if node.init is not None else set(assigned)
+            self._locals_declared.add(node.name)
+            if node.init is not None:
+                return assigned | {node.name}
+            return assigned - {node.name}
+        elif isinstance(node, c_ast.Assignment):
+            if node.op != '=':
+                assigned = self._assigned_after(node.lvalue, assigned)
+            assigned = self._assigned_after(node.rvalue, assigned)
+            if assigned is not None and isinstance(node.lvalue, c_ast.ID):
+                return assigned | {node.lvalue.name}
+            return assigned
+        elif isinstance(node, c_ast.BinaryOp) and node.op in ('&&', '||'):
+            assigned = self._assigned_after(node.left, assigned)
+            self._assigned_after(node.right, assigned)
+            return assigned
+        elif isinstance(node, c_ast.If):
+            assigned = self._assigned_after(node.cond, assigned)
+            return self._intersect(self._assigned_after(node.iftrue, assigned),
+                self._assigned_after(node.iffalse, assigned) if node.iffalse is not None else assigned)
+        elif isinstance(node, c_ast.Switch):
+            assigned = self._assigned_after(node.cond, assigned)
+            switch_assigned, self._switch_assigned = self._switch_assigned, assigned
+            try:
+                self._assigned_after(node.stmt, assigned)
+            finally:
+                self._switch_assigned = switch_assigned
+            return assigned
+        elif isinstance(node, (c_ast.While, c_ast.For)):
+            if isinstance(node, c_ast.For) and node.init is not None:
+                assigned = self._assigned_after(node.init, assigned)
+            if node.cond is not None:
+                assigned = self._assigned_after(node.cond, assigned)
+            body_assigned = self._assigned_after(node.stmt, assigned)
+            if isinstance(node, c_ast.For) and node.next is not None:
+                self._assigned_after(node.next, body_assigned if body_assigned is not None else assigned)
+            return assigned
+        elif isinstance(node, c_ast.DoWhile):
+            body_assigned = self._assigned_after(node.stmt, assigned)
+            return self._assigned_after(node.cond, body_assigned if body_assigned is not None else assigned)
+        elif isinstance(node, c_ast.Compound):
+            declared = self._locals_declared
+            self._locals_declared = set(declared)
+            try:
+                inner_assigned = assigned
+                for item_node in (node.block_items or []):
+                    inner_assigned = self._assigned_after(item_node, inner_assigned)
+            finally:
+                inner_declared, self._locals_declared = self._locals_declared - declared, declared
+            if inner_assigned is None:
+                return None
+            return (inner_assigned - inner_declared) | (assigned & inner_declared)
+        elif isinstance(node, (c_ast.Case, c_ast.Default)):
+            assigned = self._intersect(assigned, self._switch_assigned)   ## reached by fall through or dispatch
+            for stmt_node in node.stmts:
+                assigned = self._assigned_after(stmt_node, assigned)
+            return assigned
+        elif isinstance(node, c_ast.Return):
+            if node.expr is not None:
+                self._assigned_after(node.expr, assigned)
+            return None
+        elif isinstance(node, (c_ast.Break, c_ast.Continue)):
+            return None
+        for child_name, child_node in node.children():
+            assigned = self._assigned_after(child_node, assigned)
+        return assigned
+
+    @staticmethod
+    def _intersect(assigned_a, assigned_b):
+        if assigned_a is None:
+            return assigned_b
+        if assigned_b is None:
+            return assigned_a
+        return assigned_a & assigned_b
+
+    def _step(self):
+        self.step_count += 1
+        if self.step_count > EVAL_MAX_STEPS:
+            raise self.NotEvaluable()
+
+    def _exec(self, node, env, depth):
+        self._step()
+        if isinstance(node, c_ast.Compound):
+            inner_env = env.new_child()
+            for item_node in (node.block_items or []):
+                self._exec(item_node, inner_env, depth)
+        elif isinstance(node, c_ast.Decl):
+            if not isinstance(node.type, c_ast.TypeDecl) or not isinstance(node.type.type, c_ast.IdentifierType):
+                raise self.NotEvaluable()
+            env.maps[0][node.name] = self._eval(node.init, env, depth) if node.init is not None else None
+        elif isinstance(node, c_ast.If):
+            if self._eval(node.cond, env, depth):
+                self._exec(node.iftrue, env, depth)
+            elif node.iffalse is not None:
+                self._exec(node.iffalse, env, depth)
+        elif isinstance(node, (c_ast.While, c_ast.DoWhile, c_ast.For)):
+            loop_env = env.new_child()
+            if isinstance(node, c_ast.For) and node.init is not None:
+                self._exec(node.init, loop_env, depth)
+            is_first = isinstance(node, c_ast.DoWhile)
+            while is_first or node.cond is None or self._eval(node.cond, loop_env, depth):
+                is_first = False
+                try:
+                    self._exec(node.stmt, loop_env, depth)
+                except self.Break:
+                    break
+                except self.Continue:
+                    pass
+                if isinstance(node, c_ast.For) and node.next is not None:
+                    self._exec(node.next, loop_env, depth)
+                self._step()
+        elif isinstance(node, c_ast.Switch):
+            value = self._eval(node.cond, env, depth)
+            items = [node.stmt]
+            if isinstance(node.stmt, c_ast.Compound):
+                items = node.stmt.block_items or []
+            i_start = None
+            for i_item, item_node in enumerate(items):
+                if isinstance(item_node, c_ast.Case) and self._eval(item_node.expr, env, depth) == value:
+                    i_start = i_item
+                    break
+                elif isinstance(item_node, c_ast.Default):
+                    i_start = i_item if i_start is None else i_start
+            if i_start is None:
+                return
+            switch_env = env.new_child()
+            try:
+                for item_node in items[i_start:]:
+                    for stmt_node in (item_node.stmts if isinstance(item_node, (c_ast.Case, c_ast.Default)) else [item_node]):
+                        self._exec(stmt_node, switch_env, depth)
+            except self.Break:
+                pass
+        elif isinstance(node, c_ast.Return):
+            raise self.Return(self._eval(node.expr, env, depth) if node.expr is not None else None)
+        elif isinstance(node, c_ast.Break):
+            raise self.Break()
+        elif isinstance(node, c_ast.Continue):
+            raise self.Continue()
+        elif isinstance(node, c_ast.ExprList):
+            for expr_node in node.exprs:
+                self._eval(expr_node, env, depth)
+        elif isinstance(node, c_ast.DeclList):
+            for decl_node in node.decls:
+                self._exec(decl_node, env, depth)
+        elif not isinstance(node, (c_ast.EmptyStatement, c_ast.Pragma)):
+            self._eval(node, env, depth)
+
+    def _eval(self, node, env, depth):
+        ## returns int, value of expression node
+        self._step()
+        if isinstance(node, c_ast.Constant):
+            if node.type != 'int':
+                raise self.NotEvaluable()
+            return AstConstantFolder.int32(AstConstantFolder.parse_int(node.value))
+        elif isinstance(node, c_ast.ID):
+            if node.name in env:
+                value = env[node.name]
+            else:
+                value = self.global_names.get(node.name, None)
+            if not isinstance(value, int):
+                raise self.NotEvaluable()   ## uninitialized local or global variable access
+            return value
+        elif isinstance(node, c_ast.UnaryOp):
+            if node.op in ('++', '--', 'p++', 'p--'):
+                old_value = self._eval(node.expr, env, depth)
+                new_value = AstConstantFolder.int32(old_value + (1 if node.op in ('++', 'p++') else -1))
+                self._store(node.expr, new_value, env)
+                return old_value if node.op[0] == 'p' else new_value
+            value = AstConstantFolder.eval_unary_op(node.op, self._eval(node.expr, env, depth))
+        elif isinstance(node, c_ast.BinaryOp):
+            lhs_value = self._eval(node.left, env, depth)
+            if node.op == '&&' and not lhs_value or node.op == '||' and lhs_value:
+                return int(node.op == '||')
+            value = AstConstantFolder.eval_binary_op(node.op, lhs_value, self._eval(node.right, env, depth))
+        elif isinstance(node, c_ast.Assignment):
+            value = self._eval(node.rvalue, env, depth)
+            if node.op != '=':
+                value = AstConstantFolder.eval_binary_op(node.op[:-1], self._eval(node.lvalue, env, depth), value)
+                if value is None:
+                    raise self.NotEvaluable()
+            self._store(node.lvalue, value, env)
+        elif isinstance(node, c_ast.FuncCall) and isinstance(node.name, c_ast.ID):
+            arg_values = tuple(self._eval(arg_node, env, depth) for arg_node in
+                (node.args.exprs if node.args is not None else []))
+            value = self._call(node.name.name, arg_values, depth + 1)
+        else:
+            raise self.NotEvaluable()
+        if value is None:
+            raise self.NotEvaluable()       ## division by zero, shift out of range, void function value
+        return value
+
+    def _store(self, node, value, env):
+        if isinstance(node, c_ast.ID):
+            for scope_map in env.maps:
+                if node.name in scope_map:
+                    scope_map[node.name] = value
+                    return
+        raise self.NotEvaluable()           ## global variable write
+
+## ---------------------------------------------------------------------------
+
 class AstCompiler:
     UNARY_OP_INSTR = {                      ## 3 arithmetic + 1 logical ops
         '+':  None,                         ## A=+A; F=undef/A (CIS/EIS)
@@ -642,12 +2345,42 @@ class AstCompiler:
         '<':  'LT',                         ## A=(A <  x); F=undef/A (CIS/EIS); A:(0|1)
         '<=': 'LE' }                        ## A=(A <= x); F=undef/A (CIS/EIS); A:(0|1)
 
+    NEGATED_COMPARISON = {                  ## !(A <OP> x) == (A <NEGATED-OP> x)
+        '==': '!=', '!=': '==', '<': '>=', '>=': '<', '>': '<=', '<=': '>' }
+
+    SWAPPED_COMPARISON = {                  ## (A <OP> x) == (x <SWAPPED-OP> A)
+        '==': '==', '!=': '!=', '<': '>', '>': '<', '<=': '>=', '>=': '<=' }
+
+    NON_NEGATIVE_OP = ('&&', '||', '==', '!=', '<', '>', '<=', '>=')  ## binary ops with a 0 or 1 result
+
+    SWAPPED_OP = {                          ## (A <OP> x) == (x <OP> A)
+        '+': '+', '*': '*', '&': '&', '|': '|', '^': '^', '==': '==', '!=': '!=' }
+
+    EIS_SWAPPED_OP = {                      ## EIS only, the CIS helpers compute A - x, whose overflow depends on the order
+        **SWAPPED_OP, '<': '>', '>': '<', '<=': '>=', '>=': '<=' }
+
+    LOOP_COUNTER_STOP = {                   ## tuple(step, delta), "i <OP> bound" counting by step ends at bound + delta
+        '<': (1, 0), '<=': (1, 1), '>': (-1, 0), '>=': (-1, -1), '!=': (None, 0) }
+
     PARAM_PATTERN = re.compile(r'(?:.*_)?(p[0-9])(?:_.*)?')
 
-    def __init__(self, log, c_sources, use_cis=True):
+    def __init__(self, log, c_sources, use_cis=True, cost_model=None, strength_reduce=True, hoist_invariants=True,
+            count_loops=True, output_gpios=None, unroll_growth=None, call_evaluator=None, profile=None,
+            optimize_size=False, passes=None):
         self.log = log                      ## PccLogger, log sink
         self.c_sources = c_sources          ## CSourceBundle, C sources to compile
         self.use_cis = use_cis              ## bool, True: use classic instruction set, else: extended instruction set
+        self.cost_model = cost_model if cost_model is not None else VmCostModel() ## VmCostModel, instruction weights
+        self.strength_reduce = strength_reduce  ## bool, True: replace "*", "/" and "%" by constants with cheaper code
+        self.hoist_invariants = hoist_invariants ## bool, True: compute loop-invariant expressions in front of loops
+        self.count_loops = count_loops      ## bool, True: test the flags of INR/DCR in counting for loops
+        self.output_gpios = output_gpios    ## None or set(int), output GPIOs whose constant writes may be merged
+        self.set_output_gpios = set()       ## set(int), output_gpios the current function body has set to output mode
+        self.unroll_growth = unroll_growth  ## None or tuple(int stmt_growth, int tag_growth), size limits of unrolling
+        self.call_evaluator = call_evaluator ## None or AstFunctionEvaluator, evaluates calls in unrolled loop bodies
+        self.profile = profile              ## None or PccProfile, guides branch layout and unrolling
+        self.optimize_size = optimize_size  ## bool, True: never trade code size for fewer executed instructions
+        self.passes = passes                ## None or PccPasses, accounts compile time per optimization pass
         self.functions = {}                 ## dict(str func_name: Function function), user-defined and VM API functions
         self.init_asm_buf = AsmBuffer()     ## AsmBuffer, topmost output buffer
         self.asm_out = self.init_asm_buf    ## AsmBuffer, current output buffer
@@ -657,9 +2390,22 @@ class AstCompiler:
         self.loop_continue_tag = None       ## None or AsmTag, current tag to JMP to in case of a "continue" statement
         self.loop_break_tag = None          ## None or AsmTag, current tag to JMP to in case of a "break" statement
         self.in_expression = False          ## bool, True: currently evaluating an expression
+        self.temp_depth = 0                 ## int, number of compiler temporaries currently holding operands
+        self.invariant_count = 0            ## int, number of loop-invariant expressions hoisted so far
+        self.loop_names = {}                ## dict(AsmTag asm_tag: str loop_name), loop head tags for the cost report
+        self.unroll_hint = None             ## None or int, unroll factor of the next for loop ("#pragma unroll", 0: fully)
         if use_cis:
             self.em_instrs = EmulatedInstrs() ## EmulatedInstrs, set of emulated instructions used
 
+    def declare_header(self, header):
+        ## declare symbols and functions of VmApiHeader header in the global scope
+        self.scope.maps[0].update(header.symbols)
+        self.functions.update(header.functions)
+
+    def timed(self, pass_name):
+        ## returns context manager, accounts the compile time of its block to pass_name (see PccPasses)
+        return self.passes.timed(pass_name) if self.passes is not None else contextlib.nullcontext()
+
     def compile(self, ast_root_node):
         for node in ast_root_node:
             try:
@@ -676,6 +2422,10 @@ class AstCompiler:
     def pop_scope(self):
         self.scope = self.scope.parents
 
+    def name_loop(self, node, loop_kind, head_tag):
+        filename, row = self.c_sources.map_coord(node.coord.line)
+        self.loop_names[head_tag] = f'{loop_kind} loop at {PurePath(filename).name}:{row}'
+
     def push_loop_tags(self, begin_tag, end_tag):
         self.loop_tag_stack.append((self.loop_continue_tag, self.loop_break_tag))
         self.loop_continue_tag = begin_tag
@@ -768,8 +2518,405 @@ class AstCompiler:
             result = var_sym.asm_repr()
         return result
 
+    def is_non_negative(self, node):
+        ## returns bool, True if the value of expression node is provably >= 0
+        const_value = self.try_parse_constant(node)
+        if const_value is not None:
+            return int(const_value, 0) >= 0
+        if isinstance(node, c_ast.UnaryOp):
+            return node.op == '!'
+        if not isinstance(node, c_ast.BinaryOp):
+            return False
+        if node.op in self.NON_NEGATIVE_OP:
+            return True
+        elif node.op == '&':
+            return self.is_non_negative(node.left) or self.is_non_negative(node.right)
+        elif node.op in ('|', '^', '>>', '%'):           ## sign of ">>" and "%" follows the lhs
+            return self.is_non_negative(node.left) and (node.op in ('>>', '%') or self.is_non_negative(node.right))
+        elif node.op == '/':
+            rhs_const = self.try_parse_constant(node.right)
+            return rhs_const is not None and int(rhs_const, 0) > 0 and self.is_non_negative(node.left)
+        return False
+
+    def register_need(self, node):
+        ## returns int, number of temporaries needed to evaluate expression node into A (Sethi-Ullman number)
+        if self.try_parse_term(node) is not None:
+            return 0
+        if isinstance(node, c_ast.UnaryOp):
+            return 0 if node.op in ('++', '--', 'p++', 'p--') else self.register_need(node.expr)
+        elif isinstance(node, c_ast.BinaryOp):
+            lhs_need, rhs_need = self.register_need(node.left), self.register_need(node.right)
+            if self.try_parse_term(node.right) is not None:
+                return lhs_need
+            elif self.try_parse_term(node.left) is not None:
+                return rhs_need
+            return lhs_need + 1 if lhs_need == rhs_need else max(lhs_need, rhs_need)
+        elif isinstance(node, c_ast.Assignment):
+            return self.register_need(node.rvalue)
+        elif isinstance(node, c_ast.FuncCall) and node.args is not None:
+            return max((self.register_need(arg_node) for arg_node in node.args.exprs), default=0)
+        return 0
+
+    def expression_effects(self, node):
+        ## returns tuple(bool has_side_effects, set read_vars, set written_vars), variables (AsmVar or str
+        ## VM parameter) accessed by expression node, None stands for any global variable or VM parameter
+        if self.try_parse_constant(node) is not None:
+            return False, set(), set()
+        node_term = self.try_parse_term(node)
+        if node_term is not None:
+            return False, {node_term}, set()
+        if isinstance(node, c_ast.UnaryOp):
+            has_side_effects, read_vars, written_vars = self.expression_effects(node.expr)
+            if node.op in ('++', '--', 'p++', 'p--'):
+                return True, read_vars, written_vars | read_vars
+            return has_side_effects, read_vars, written_vars
+        elif isinstance(node, c_ast.BinaryOp):
+            lhs_effects, rhs_effects = self.expression_effects(node.left), self.expression_effects(node.right)
+            return lhs_effects[0] or rhs_effects[0], lhs_effects[1] | rhs_effects[1], lhs_effects[2] | rhs_effects[2]
+        elif isinstance(node, c_ast.Assignment) and isinstance(node.lvalue, c_ast.ID):
+            has_side_effects, read_vars, written_vars = self.expression_effects(node.rvalue)
+            lhs_term = self.try_parse_term(node.lvalue)
+            return True, read_vars | {lhs_term}, written_vars | {lhs_term}
+        elif isinstance(node, c_ast.FuncCall) and isinstance(node.name, c_ast.ID):
+            read_vars, written_vars = set(), set()
+            for arg_node in (node.args.exprs if node.args is not None else []):
+                has_side_effects, arg_read_vars, arg_written_vars = self.expression_effects(arg_node)
+                read_vars |= arg_read_vars
+                written_vars |= arg_written_vars
+            func_sym = self.find_symbol(node.name.name, filter=FunctionSymbol)
+            if func_sym is None or not isinstance(func_sym.function, VmApiFunction):
+                read_vars.add(None)             ## user-defined function or asm(): may access any global variable
+                written_vars.add(None)
+            return True, read_vars, written_vars
+        return True, {None}, {None}
+
+    def is_reorderable(self, node_a, node_b):
+        ## returns bool, True if evaluating expression node_b before node_a yields the same results
+        a_side_effects, a_read_vars, a_written_vars = self.expression_effects(node_a)
+        b_side_effects, b_read_vars, b_written_vars = self.expression_effects(node_b)
+        if a_side_effects and b_side_effects:
+            return False
+        is_global = lambda v: v is None or isinstance(v, str) or v.var_sym is None or v.var_sym.context_function is None
+        for written_vars, accessed_vars in ((a_written_vars, b_read_vars | b_written_vars), (b_written_vars, a_read_vars)):
+            if written_vars & accessed_vars:
+                return False
+            if None in written_vars and any(is_global(v) for v in accessed_vars):
+                return False
+            if None in accessed_vars and any(is_global(v) for v in written_vars):
+                return False
+        return True
+
+    def argument_order(self, function, arg_exprs):
+        ## returns list(int), order to compute the arguments arg_exprs of a call of user-defined function:
+        ## computed arguments first, then the first argument (computed last in A, see AccumulatorArgPasser)
+        ## and at last constants and variables (loaded right in front of the CALL, see FunctionInliner),
+        ## unless that changes argument values or the order of side effects
+        in_order = list(range(len(arg_exprs)))
+        if len(arg_exprs) < 2:
+            return in_order
+        effects = [self.expression_effects(arg_expr_node) for arg_expr_node in arg_exprs]
+        if any(read_vars & set(function.arg_vars) for has_side_effects, read_vars, written_vars in effects):
+            return in_order                 ## recursive call reading the arguments it assigns
+        is_term = [self.try_parse_term(arg_expr_node) is not None for arg_expr_node in arg_exprs]
+        computed, terms = [i for i in in_order[1:] if not is_term[i]], [i for i in in_order[1:] if is_term[i]]
+        if None in effects[0][1]:           ## calls a user-defined function, which may assign arguments
+            arg_order = [0] + computed + terms
+        else:
+            arg_order = computed + [0] + terms
+        for i_pos, i_arg in enumerate(arg_order):
+            if any(j_arg < i_arg and not self.is_reorderable(arg_exprs[j_arg], arg_exprs[i_arg])
+                    for j_arg in arg_order[i_pos + 1:]):
+                return in_order
+        return arg_order
+
+    def acquire_temp(self):
+        ## returns AsmVar, compiler temporary of the current nesting depth, to be released with release_temp()
+        function = self.context_function
+        if self.temp_depth == len(function.temp_vars):
+            temp_sym = VmVariableSymbol('int', f'.tmp{self.temp_depth}', None, function.decl_node, function)
+            function.temp_vars.append(temp_sym.asm_repr())
+        self.temp_depth += 1
+        return function.temp_vars[self.temp_depth - 1]
+
+    def release_temp(self):
+        self.temp_depth -= 1
+
+    def hoist_loop_invariants(self, loop_node):
+        ## loop-invariant code motion: pure sub-expressions of the condition, iteration expression and body
+        ## of loop_node which only read variables the loop never writes are computed once in front of the
+        ## loop (preheader) into new local variables, which replace them in the AST
+        if not self.hoist_invariants or self.context_function is None:
+            return
+        loop_children = [(child_name, child_node) for child_name, child_node in loop_node.children()
+            if child_name in ('cond', 'next', 'stmt')]
+        written_cnames, declared_cnames = set(), set()
+        for child_name, child_node in loop_children:
+            if not self.collect_loop_writes(child_node, written_cnames, declared_cnames):
+                return                      ## asm() statements may write any variable
+        invariant_syms = {}                 ## dict(str c_expr: VmVariableSymbol), hoisted expressions
+        for child_name, child_node in loop_children:
+            self._hoist_invariants(loop_node, child_name, child_node, child_name == 'cond',
+                written_cnames, declared_cnames, invariant_syms)
+
+    def collect_loop_writes(self, node, written_cnames, declared_cnames):
+        ## adds names of variables written and declared in node to the sets, None stands for any global
+        ## variable or VM parameter (written by user-defined functions)
+        ## returns bool, False if node contains an asm() statement
+        if isinstance(node, c_ast.Decl):
+            declared_cnames.add(node.name)
+        elif isinstance(node, c_ast.Assignment) and isinstance(node.lvalue, c_ast.ID):
+            written_cnames.add(node.lvalue.name)
+        elif isinstance(node, c_ast.UnaryOp) and node.op in ('++', '--', 'p++', 'p--') and \
+                isinstance(node.expr, c_ast.ID):
+            written_cnames.add(node.expr.name)
+        elif isinstance(node, c_ast.FuncCall) and isinstance(node.name, c_ast.ID):
+            if node.name.name == 'asm':
+                return False
+            func_sym = self.find_symbol(node.name.name, filter=FunctionSymbol)
+            if func_sym is None or not isinstance(func_sym.function, VmApiFunction):
+                written_cnames.add(None)
+        return all(self.collect_loop_writes(child_node, written_cnames, declared_cnames)
+            for child_name, child_node in node.children())
+
+    def is_loop_invariant(self, node, written_cnames, declared_cnames):
+        ## returns bool, True if expression node is pure, cannot trap and only reads variables which are
+        ## neither written nor declared in the loop, and no VM parameters
+        if isinstance(node, c_ast.Constant):
+            return node.type == 'int'
+        elif isinstance(node, c_ast.ID):
+            if node.name in written_cnames or node.name in declared_cnames:
+                return False
+            symbol = self.find_symbol(node.name)
+            if isinstance(symbol, VmVariableSymbol) and symbol.context_function is not None:
+                return True
+            if isinstance(symbol, VmVariableSymbol):
+                return None not in written_cnames
+            return isinstance(symbol, EnumSymbol)   ## VM parameters are volatile, the host may update them
+        elif isinstance(node, c_ast.UnaryOp):
+            return node.op in self.UNARY_OP_INSTR and self.is_loop_invariant(node.expr, written_cnames, declared_cnames)
+        elif isinstance(node, c_ast.BinaryOp) and node.op in self.BINARY_OP_INSTR:
+            if node.op in ('/', '%'):       ## hoisting must not raise a division by zero the loop avoids
+                rhs_const = self.try_parse_constant(node.right)
+                if rhs_const is None or int(rhs_const, 0) == 0:
+                    return False
+            return self.is_loop_invariant(node.left, written_cnames, declared_cnames) and \
+                self.is_loop_invariant(node.right, written_cnames, declared_cnames)
+        return False
+
+    def _hoist_invariants(self, parent_node, child_name, node, in_condition, written_cnames, declared_cnames,
+            invariant_syms):
+        ## a branch condition is not hoisted itself, it is cheaper to test than to load
+        if not in_condition and isinstance(node, (c_ast.UnaryOp, c_ast.BinaryOp)) and \
+                self.try_parse_constant(node) is None and \
+                self.is_loop_invariant(node, written_cnames, declared_cnames):
+            c_expr = CGenerator().visit(node)
+            inv_sym = invariant_syms.get(c_expr, None)
+            if inv_sym is None:
+                if len(invariant_syms) == LOOP_MAX_INVARIANTS:
+                    return
+                inv_sym = self.declare_variable(node, 'int', f'.inv{self.invariant_count}')
+                self.invariant_count += 1
+                self.compile_assignment(inv_sym.asm_repr(), node)  ## inv_var := (invariant-expr)
+                invariant_syms[c_expr] = inv_sym
+            AstConstantFolder._replace_child(parent_node, child_name, c_ast.ID(inv_sym.cname, coord=node.coord))
+            return
+        for grandchild_name, grandchild_node in node.children():
+            if isinstance(node, c_ast.Case) and grandchild_name == 'expr':
+                continue
+            is_condition = (grandchild_name == 'cond' and isinstance(node, (c_ast.If, c_ast.While, c_ast.DoWhile,
+                c_ast.For))) or (in_condition and ((isinstance(node, c_ast.BinaryOp) and node.op in ('&&', '||'))
+                or (isinstance(node, c_ast.UnaryOp) and node.op == '!')))
+            self._hoist_invariants(node, grandchild_name, grandchild_node, is_condition, written_cnames,
+                declared_cnames, invariant_syms)
+
+    def strength_reduction(self, op, rhs_const, lhs_non_negative):
+        ## returns None or list(tuple(str instr, arg)), code computing A := A <OP> rhs_const; F := A
+        ## that is cheaper than the plain MLT, DIV or MOD instruction (SCR0 is used as scratch), and not
+        ## longer if optimize_size is set
+        op_instr = self.BINARY_OP_INSTR[op]
+        if not self.strength_reduce or op_instr not in ('MLT', 'DIV', 'MOD'):
+            return None
+        value = int(rhs_const, 0)
+        if value <= 1:
+            return None
+        k = value.bit_length() - 1
+        if op_instr == 'MLT':
+            low = value & -value                        ## x * (2^a +/- 2^b) == ((x << (a-b)) +/- x) << b
+            high = value - low
+            if high == 0:
+                sequences = [[('RLA', k)]]
+            else:
+                b = low.bit_length() - 1
+                sequences = []
+                if high & (high - 1) == 0:
+                    sequences.append([('STA', SCR0), ('RLA', high.bit_length() - 1 - b), ('ADD', SCR0)])
+                if (value + low) & (value + low - 1) == 0:
+                    sequences.append([('STA', SCR0), ('RLA', (value + low).bit_length() - 1 - b), ('SUB', SCR0)])
+                sequences = [sequence + [('RLA', b)] if b > 0 else sequence for sequence in sequences]
+        elif value & (value - 1) != 0:
+            return None
+        elif lhs_non_negative:
+            sequences = [[('RRA', k)] if op_instr == 'DIV' else [('AND', value - 1)]]
+        elif op_instr == 'DIV':                         ## round towards zero: add 2^k-1 to a negative lhs
+            sequences = [[('STA', SCR0), ('RRA', 31), ('AND', value - 1), ('ADD', SCR0), ('RRA', k)]]
+        else:                                           ## x % 2^k == x - (x / 2^k) * 2^k
+            sequences = [[('STA', SCR0), ('RRA', 31), ('AND', value - 1), ('ADD', SCR0), ('AND', -value),
+                ('XA', SCR0), ('SUB', SCR0)]]
+        op_cost = self.cost_model.cost(op_instr)
+        cheaper = []
+        for sequence in sequences:
+            cost = sum(self.cost_model.cost(instr) for instr, arg in sequence)
+            if (cost < op_cost or (len(sequence) == 1 and cost == op_cost)) and \
+                    (len(sequence) == 1 or not self.optimize_size):
+                cheaper.append([(instr, str(arg) if isinstance(arg, int) else arg) for instr, arg in sequence])
+        return min(cheaper, key=len, default=None)
+
     ## Code-generating functions
 
+    def compile_flag_assertion(self):
+        ## CIS: assert F == A before a conditional jump, returns comment for the jump instruction
+        if not self.use_cis:
+            return None
+        if self.asm_out.is_flag_coherent():
+            return 'F=A, OR 0 elided'
+        self.asm_out('OR', 0, comment='F=A')
+        return None
+
+    def compile_branch(self, node, target_tag, jump_if):
+        ## GOTO target_tag if bool(node-expr) == jump_if, else fall through
+        const_value = self.try_parse_constant(node)
+        if const_value is not None:                     ## constant condition: unconditional jump or nothing
+            if (int(const_value, 0) != 0) == jump_if:
+                self.asm_out('JMP', target_tag)
+        elif isinstance(node, c_ast.UnaryOp) and node.op == '!':
+            self.compile_branch(node.expr, target_tag, not jump_if)
+        elif isinstance(node, c_ast.BinaryOp) and node.op in ('&&', '||'):
+            if jump_if == (node.op == '||'):            ## "A || B" jump if TRUE, "A && B" jump if FALSE
+                self.compile_branch(node.left, target_tag, jump_if)
+                self.compile_branch(node.right, target_tag, jump_if)
+            else:                                       ## "A || B" jump if FALSE, "A && B" jump if TRUE
+                skip_tag = AsmTag()
+                self.compile_branch(node.left, skip_tag, not jump_if)
+                self.compile_branch(node.right, target_tag, jump_if)
+                self.asm_out('TAG', skip_tag)           ## TAG: skip_tag
+        elif isinstance(node, c_ast.BinaryOp) and node.op in self.NEGATED_COMPARISON and \
+                (self.use_cis or not self.may_overflow(node)):  ## EIS: exact LT, GT, LE and GE instructions
+            cmp_op = node.op if jump_if else self.NEGATED_COMPARISON[node.op]
+            self.compile_conditional_jump(self.compile_comparison(node, cmp_op), target_tag)
+        elif self.compile_flag_operand(node):           ## F := (node-expr), A unchanged
+            self.asm_out('JNZ' if jump_if else 'JZ', target_tag)
+        else:
+            self.compile_expression(node)               ## A := (node-expr); F := undef/A (CIS/EIS)
+            comment = self.compile_flag_assertion()     ## CIS: assert F := A before conditional jump
+            self.asm_out('JNZ' if jump_if else 'JZ', target_tag, comment=comment)
+
+    def may_overflow(self, node):
+        ## returns bool, True if the subtraction of CMP may overflow for ordered comparison node: neither
+        ## operand is 0 and they are not both non-negative
+        if node.op in ('==', '!='):
+            return False                                ## F == 0 tests equality despite overflows
+        for operand_node in (node.left, node.right):
+            const_value = self.try_parse_constant(operand_node)
+            if const_value is not None and int(const_value, 0) == 0:
+                return False
+        return not (self.is_non_negative(node.left) and self.is_non_negative(node.right))
+
+    def compile_comparison(self, node, cmp_op):
+        ## F := (lhs - rhs) or F := (rhs - lhs), returns F_OP such that (lhs <CMP_OP> rhs) == (F <F_OP> 0),
+        ## operands are ordered to prefer F_OP "==", "!=", "<" and ">=" which take a single jump instruction,
+        ## unless the subtraction may overflow: then F := lhs - rhs, as the CIS helper functions compute it
+        ## "X <CMP_OP> 0" and "0 <CMP_OP> X" test F if it holds X, but not at the cost of a skip tag
+        for flag_node, zero_node, f_op in ((node.left, node.right, cmp_op),
+                (node.right, node.left, self.SWAPPED_COMPARISON[cmp_op])):
+            zero_const = self.try_parse_constant(zero_node)
+            if f_op != '>' and zero_const is not None and int(zero_const, 0) == 0 and \
+                    self.compile_flag_operand(flag_node):
+                return f_op
+        ## "X <CMP_OP> 0" tests F := X itself: "CMP 1" or "0 - X" would overflow for X = INT_MIN
+        for flag_node, zero_node, f_op in ((node.left, node.right, cmp_op),
+                (node.right, node.left, self.SWAPPED_COMPARISON[cmp_op])):
+            zero_const = self.try_parse_constant(zero_node)
+            if zero_const is not None and int(zero_const, 0) == 0:
+                self.compile_expression(flag_node)      ## A := (X-expr)
+                self.asm_out('CMP', '0')                ## F := A
+                return f_op
+        lhs_term = self.try_parse_term(node.left)
+        rhs_term = self.try_parse_term(node.right)
+        is_exact = not self.may_overflow(node)
+        prefer_swapped = cmp_op in ('>', '<=') and is_exact
+        if rhs_term is not None:
+            rhs_const = self.try_parse_constant(node.right)
+            if prefer_swapped and rhs_const is not None and int(rhs_const, 0) < 0x7fffffff:
+                self.compile_expression(node.left)      ## A := (lhs-expr)
+                self.asm_out('CMP', str(int(rhs_const, 0) + 1)) ## F := A - (rhs + 1)
+                return '>=' if cmp_op == '>' else '<'   ## (A > x) == (A >= x + 1), (A <= x) == (A < x + 1)
+            elif prefer_swapped and lhs_term is not None:
+                self.asm_out('LDA', rhs_term)           ## A := rhs
+                self.asm_out('CMP', lhs_term)           ## F := rhs - lhs
+                return self.SWAPPED_COMPARISON[cmp_op]
+            self.compile_expression(node.left)          ## A := (lhs-expr)
+            self.asm_out('CMP', rhs_term)               ## F := lhs - rhs
+            return cmp_op
+        elif lhs_term is not None and is_exact:
+            self.compile_expression(node.right)         ## A := (rhs-expr)
+            self.asm_out('CMP', lhs_term)               ## F := rhs - lhs
+            return self.SWAPPED_COMPARISON[cmp_op]
+        elif lhs_term is not None:
+            self.compile_expression(node.right)         ## A := (rhs-expr)
+            self.asm_out('STA', SCR0)                   ## SCR0 := A
+            self.asm_out('LDA', lhs_term)               ## A := lhs
+            self.asm_out('CMP', SCR0)                   ## F := lhs - rhs
+            return cmp_op
+        ## evaluate the operand needing more temporaries first, prefer the order that leaves the
+        ## operand to subtract from in A
+        lhs_need, rhs_need = self.register_need(node.left), self.register_need(node.right)
+        rhs_first = self.is_reorderable(node.left, node.right) and \
+            (rhs_need > lhs_need or (rhs_need == lhs_need and not prefer_swapped))
+        if rhs_first:
+            temp_var = self.compile_operands(node.right, node.left) ## T := (rhs-expr); A := (lhs-expr)
+        else:
+            temp_var = self.compile_operands(node.left, node.right) ## T := (lhs-expr); A := (rhs-expr)
+        if rhs_first == prefer_swapped:
+            self.asm_out('XA', temp_var)                ## exchange A and T
+        self.asm_out('CMP', temp_var)                   ## F := lhs - rhs or F := rhs - lhs (prefer_swapped)
+        return self.SWAPPED_COMPARISON[cmp_op] if prefer_swapped else cmp_op
+
+    def compile_flag_operand(self, node):
+        ## returns bool, True if F holds the value of expression node without loading it into A: node is a
+        ## variable the preceding INR or DCR left in F, or a prefix increment or decrement compiled to one
+        if isinstance(node, c_ast.UnaryOp) and node.op in ('++', '--'):
+            prev_in_expression = self.in_expression
+            self.in_expression = False
+            try:
+                self.compile_statement(node)            ## INR X or DCR X, F := X
+            finally:
+                self.in_expression = prev_in_expression
+            return True
+        if isinstance(node, c_ast.ID) and self.try_parse_constant(node) is None:
+            flag_state = self.asm_out.flag_state
+            return flag_state is not None and flag_state is not AsmBuffer.F_EQ_A and \
+                flag_state == self.try_parse_term(node)
+        return False
+
+    def compile_conditional_jump(self, f_op, target_tag):
+        ## GOTO target_tag if (F <F_OP> 0)
+        if f_op == '==':
+            self.asm_out('JZ', target_tag)              ## IF (F == 0) GOTO target_tag
+        elif f_op == '!=':
+            self.asm_out('JNZ', target_tag)             ## IF (F != 0) GOTO target_tag
+        elif f_op == '<':
+            self.asm_out('JM', target_tag)              ## IF (F < 0) GOTO target_tag
+        elif f_op == '>=':
+            self.asm_out('JP', target_tag)              ## IF (F >= 0) GOTO target_tag
+        elif f_op == '<=':
+            self.asm_out('JZ', target_tag)              ## IF (F == 0) GOTO target_tag
+            self.asm_out('JM', target_tag)              ## IF (F < 0) GOTO target_tag
+        else:
+            skip_tag = AsmTag()
+            self.asm_out('JZ', skip_tag)                ## IF (F == 0) GOTO skip_tag
+            self.asm_out('JP', target_tag)              ## IF (F >= 0) GOTO target_tag
+            self.asm_out('TAG', skip_tag)               ## TAG: skip_tag
+
     def compile_expression(self, node):
         node_term = self.try_parse_term(node)
         if node_term is not None:
@@ -787,6 +2934,33 @@ class AstCompiler:
         else:
             raise PccError(node, 'unsupported expression syntax')
 
+    def compile_operands(self, first_node, second_node):
+        ## T := (first-expr); A := (second-expr); F := undef/A (CIS/EIS), returns AsmVar T, the
+        ## compiler temporary holding the operand evaluated first while the second one is evaluated
+        first_term = self.try_parse_term(first_node)
+        if first_term is None:
+            self.compile_expression(first_node)         ## A := (first-expr)
+        temp_var = self.acquire_temp()
+        try:
+            if first_term is None:
+                self.asm_out('STA', temp_var)           ## T := A
+            else:
+                self.asm_out('LD', temp_var, first_term) ## T := (first-term)
+            self.compile_expression(second_node)        ## A := (second-expr); F := undef/A (CIS/EIS)
+        finally:
+            self.release_temp()
+        return temp_var
+
+    def compile_operation(self, op, x):
+        ## A := A <OP> x; F := undef/A (CIS/EIS)
+        op_instr = self.BINARY_OP_INSTR[op]
+        if self.use_cis and self.em_instrs.is_emulated(op_instr):
+            if x != SCR0:
+                self.asm_out('LD', SCR0, x)
+            self.em_instrs.compile(self, op_instr)      ## CIS: A := A <OP> x; F := undef
+        else:
+            self.asm_out(op_instr, x)                   ## CIS/EIS: A := A <OP> x, F := A
+
     def compile_assignment(self, dst_reg, rhs_node, assign_op='='):
         rhs_term = self.try_parse_term(rhs_node)
         if assign_op == '=':                            ## Simple assignment ("=")
@@ -802,14 +2976,28 @@ class AstCompiler:
                 self.asm_out('STA', dst_reg)            ## dst_reg := A
         elif assign_op[:-1] in self.BINARY_OP_INSTR:    ## Assignment operator ("+=", "/=", ...)
             op_instr = self.BINARY_OP_INSTR[assign_op[:-1]]
+            rhs_const = self.try_parse_constant(rhs_node)
+            reduced_code = None
+            if rhs_const is not None:
+                with self.timed('strength-reduce'):
+                    reduced_code = self.strength_reduction(assign_op[:-1], rhs_const, False)
             if rhs_term is not None:
                 op_rhs = rhs_term
+            elif assign_op[:-1] in self.SWAPPED_OP:
+                self.compile_expression(rhs_node)       ## A := (rhs-expr); F := undef/A (CIS/EIS)
+                self.asm_out(op_instr, dst_reg)         ## A := (rhs-expr) <OP> dst_reg; F := A
+                self.asm_out('STA', dst_reg)            ## dst_reg := A
+                return
             else:
                 self.compile_expression(rhs_node)       ## A := (rhs-expr); F := undef/A (CIS/EIS)
                 self.asm_out('STA', SCR0)               ## SCR0 := A
                 op_rhs = SCR0
             self.asm_out('LDA', dst_reg)                ## A := dest_reg
-            self.asm_out(op_instr, op_rhs)              ## A := A <OP> op_rhs; F := A
+            if reduced_code is not None:
+                for instr, arg in reduced_code:
+                    self.asm_out(instr, arg)            ## A := A <OP> rhs_const; F := A
+            else:
+                self.asm_out(op_instr, op_rhs)          ## A := A <OP> op_rhs; F := A
             self.asm_out('STA', dst_reg)                ## dst_reg := A
         else:
             raise PccError(rhs_node, f'unsupported assignment operator "{assign_op}"')
@@ -851,7 +3039,14 @@ class AstCompiler:
         _compile_class_node = getattr(self, f'_compile_{ast_class_name}_node', None)
         if not callable(_compile_class_node):
             raise PccError(node, f'unsupported statement syntax (AST element {ast_class_name})')
-        return _compile_class_node(node)
+        asm_buf, i_first = self.asm_out, len(self.asm_out.stmt_buf)
+        returned = _compile_class_node(node)
+        ## commands not attributed to a nested statement yet stem from this one (see AsmProfiler)
+        if node.coord is not None and asm_buf is self.asm_out:
+            for asm_stmt in asm_buf.stmt_buf[i_first:]:
+                if isinstance(asm_stmt, AsmCmd) and asm_stmt.coord is None:
+                    asm_stmt.coord = node.coord
+        return returned
 
     def _compile_UnaryOp_node(self, node):
         if node.op in ('++', '--', 'p++', 'p--'):
@@ -861,26 +3056,25 @@ class AstCompiler:
             if reg_sym is None:
                 raise PccError(node.expr, f'undefined variable "{node.expr.name}"')
             vm_reg = reg_sym.asm_repr()
-            if node.op == '++':                         ## Prefix increment "++X":
+            if not self.in_expression:                  ## Value unused ("X++;", "--X;", ...):
+                self.asm_out('INR' if node.op in ('++', 'p++') else 'DCR', vm_reg) ## ++X or --X, F := X
+            elif node.op == '++':                       ## Prefix increment "++X":
                 self.asm_out('INR', vm_reg)             ## ++X, F := X
                 self.asm_out('LDA', vm_reg)             ## A := X, F := A
             elif node.op == '--':                       ## Prefix deccrement "--X":
                 self.asm_out('DCR', vm_reg)             ## --X, F := X
                 self.asm_out('LDA', vm_reg)             ## A := X, F := A
-            elif node.op == 'p++':                      ## Postfix increment "X++":
+            elif self.use_cis:                          ## CIS: Postfix increment "X++" or decrement "X--":
+                self.asm_out('LDA', vm_reg)             ## A := X
+                self.asm_out('INR' if node.op == 'p++' else 'DCR', vm_reg) ## ++X or --X, F := X
+            elif node.op == 'p++':                      ## EIS: Postfix increment "X++":
                 self.asm_out('LD', SCR0, vm_reg)        ## SCR0 := X
                 self.asm_out('INR', vm_reg)             ## ++X, F := X
-                if self.use_cis:
-                    self.asm_out('LDA', SCR0)           ## CIS: A := SCR0, F := undef
-                else:
-                    self.asm_out('LDAF', SCR0)          ## EIS: A := SCR0, F := A
-            elif node.op == 'p--':                      ## Postfix decrement "X--":
+                self.asm_out('LDAF', SCR0)              ## A := SCR0, F := A
+            elif node.op == 'p--':                      ## EIS: Postfix decrement "X--":
                 self.asm_out('LD', SCR0, vm_reg)        ## SCR0 := X
                 self.asm_out('DCR', vm_reg)             ## --X, F := X
-                if self.use_cis:
-                    self.asm_out('LDA', SCR0)           ## CIS: A := SCR0; F := undef
-                else:
-                    self.asm_out('LDAF', SCR0)          ## EIS: A := SCR0; F := A
+                self.asm_out('LDAF', SCR0)              ## A := SCR0; F := A
         elif node.op in self.UNARY_OP_INSTR:
             self.compile_expression(node.expr)          ## A := (expr); F := undef/A (CIS/EIS)
             op_instr = self.UNARY_OP_INSTR[node.op]
@@ -896,26 +3090,57 @@ class AstCompiler:
     def _compile_BinaryOp_node(self, node):
         if node.op not in self.BINARY_OP_INSTR:
             raise PccError(node, f'unsupported binary operator "{node.op}"')
-        op_instr = self.BINARY_OP_INSTR[node.op]
-        ## compile left-hand side (lhs) into ACC
-        self.compile_expression(node.left)              ## A := (lhs-expr); F := undef/A (CIS/EIS)
-        ## compile right-hand side (rhs) and combine with lhs using <OP>
-        rhs_term = self.try_parse_term(node.right)
-        if rhs_term is not None:
-            if self.use_cis and self.em_instrs.is_emulated(op_instr):
-                self.asm_out('LD', SCR0, rhs_term)
-                self.em_instrs.compile(self, op_instr)  ## CIS: A := A <OP> x; F := undef
+        lhs_node, rhs_node = node.left, node.right
+        if node.op == '*' and self.try_parse_constant(lhs_node) is not None and \
+                self.try_parse_constant(rhs_node) is None:
+            lhs_node, rhs_node = rhs_node, lhs_node     ## "c * x" => "x * c"
+        rhs_const = self.try_parse_constant(rhs_node)
+        reduced_code = None
+        if rhs_const is not None:
+            with self.timed('strength-reduce'):
+                reduced_code = self.strength_reduction(node.op, rhs_const, self.is_non_negative(lhs_node))
+        rhs_term = self.try_parse_term(rhs_node)
+        if reduced_code is not None or rhs_term is not None:
+            ## compile left-hand side (lhs) into ACC and combine with rhs term using <OP>
+            self.compile_expression(lhs_node)           ## A := (lhs-expr); F := undef/A (CIS/EIS)
+            if reduced_code is not None:
+                for instr, arg in reduced_code:
+                    self.asm_out(instr, arg)            ## A := A <OP> rhs_const; F := A
             else:
-                self.asm_out(op_instr, rhs_term)        ## CIS/EIS: A := A <OP> x, F := A
-        else:
+                self.compile_operation(node.op, rhs_term)   ## A := A <OP> x; F := undef/A (CIS/EIS)
+            return False
+        lhs_term = self.try_parse_term(lhs_node)
+        swapped_op = (self.SWAPPED_OP if self.use_cis else self.EIS_SWAPPED_OP).get(node.op, None)
+        if self.context_function is None:               ## global initializer, no temporaries
+            self.compile_expression(lhs_node)           ## A := (lhs-expr); F := undef/A (CIS/EIS)
             self.asm_out('PUSHA')                       ## save ACC (lhs) onto stack
-            self.compile_expression(node.right)         ## A := (rhs-expr); F := undef/A (CIS/EIS)
+            self.compile_expression(rhs_node)           ## A := (rhs-expr); F := undef/A (CIS/EIS)
             self.asm_out('STA', SCR0)                   ## SCR0 := A
             self.asm_out('POPA')                        ## restore lhs in ACC from stack
-            if self.use_cis and self.em_instrs.is_emulated(op_instr):
-                self.em_instrs.compile(self, op_instr)  ## CIS: A := A <OP> SCR0; F := undef
+            self.compile_operation(node.op, SCR0)       ## A := A <OP> SCR0; F := undef/A (CIS/EIS)
+        elif lhs_term is not None and self.is_reorderable(lhs_node, rhs_node):
+            self.compile_expression(rhs_node)           ## A := (rhs-expr); F := undef/A (CIS/EIS)
+            if swapped_op is not None:
+                self.compile_operation(swapped_op, lhs_term)    ## A := A <SWAPPED-OP> lhs
             else:
-                self.asm_out(op_instr, SCR0)            ## CIS/EIS: A := A <OP> SCR0, F := A
+                self.asm_out('STA', SCR0)               ## SCR0 := A
+                self.asm_out('LDA', lhs_term)           ## A := lhs
+                self.compile_operation(node.op, SCR0)   ## A := A <OP> SCR0; F := undef/A (CIS/EIS)
+        else:
+            ## evaluate the operand needing more temporaries first (Sethi-Ullman), without
+            ## commutative <OP> prefer the order that leaves lhs in ACC
+            lhs_need, rhs_need = self.register_need(lhs_node), self.register_need(rhs_node)
+            if (rhs_need > lhs_need or (rhs_need == lhs_need and swapped_op is None)) and \
+                    self.is_reorderable(lhs_node, rhs_node):
+                temp_var = self.compile_operands(rhs_node, lhs_node)    ## T := (rhs-expr); A := (lhs-expr)
+                self.compile_operation(node.op, temp_var)   ## A := A <OP> T
+            else:
+                temp_var = self.compile_operands(lhs_node, rhs_node)    ## T := (lhs-expr); A := (rhs-expr)
+                if swapped_op is not None:
+                    self.compile_operation(swapped_op, temp_var)    ## A := A <SWAPPED-OP> T
+                else:
+                    self.asm_out('XA', temp_var)        ## exchange A (rhs) and T (lhs)
+                    self.compile_operation(node.op, temp_var)   ## A := A <OP> T
         return False
 
     def _compile_Assignment_node(self, node):
@@ -926,24 +3151,128 @@ class AstCompiler:
         self.compile_assignment(lhs_reg, node.rvalue, assign_op=node.op)
         return False
 
+    def compile_block_items(self, block_items):
+        ## compile statements up to the first one that returns or jumps away, returns True if it returned
+        returned = False
+        in_unreachable_code = False
+        i_item = 0
+        while i_item < len(block_items):
+            statement_node = block_items[i_item]
+            i_item += 1
+            if in_unreachable_code:
+                self.log.warning(statement_node, 'unreachable code', self.context_function)
+                break
+            if self.unroll_hint is not None and not isinstance(statement_node, (c_ast.For, c_ast.Pragma)):
+                self.log.warning(statement_node, '"#pragma unroll" expects a "for" loop', self.context_function)
+                self.unroll_hint = None
+            with self.timed('merge-writes'):
+                gpio_writes = self.parse_gpio_writes(block_items[i_item - 1:])
+                if gpio_writes is not None:
+                    self.compile_gpio_writes(gpio_writes, statement_node)
+            if gpio_writes is not None:
+                i_item += len(gpio_writes) - 1
+                continue
+            try:
+                s_returned = self.compile_statement(statement_node)
+                if self.context_function is not None and block_items is self.context_function.impl_node.body.block_items:
+                    self.set_output_gpio(statement_node)
+                if s_returned:
+                    returned = True
+                if s_returned or isinstance(statement_node, (c_ast.Continue, c_ast.Break)):
+                    in_unreachable_code = True
+            except PccError as e:
+                self.log.error(e, context_function=self.context_function)
+        if self.unroll_hint is not None:
+            self.log.warning(block_items[-1], '"#pragma unroll" expects a "for" loop', self.context_function)
+            self.unroll_hint = None
+        return returned
+
+    def set_output_gpio(self, statement_node):
+        ## a statement "gpioSetMode(gpio, PI_OUTPUT);" of the function body precedes all statements compiled
+        ## after it, a merged write of gpio is executed after the mode change, as a WRITE would make it
+        if self.output_gpios and isinstance(statement_node, c_ast.FuncCall) and \
+                isinstance(statement_node.name, c_ast.ID) and statement_node.name.name == 'gpioSetMode' and \
+                statement_node.args is not None and len(statement_node.args.exprs) == 2:
+            gpio, mode = [self.try_parse_constant(arg_node) for arg_node in statement_node.args.exprs]
+            if gpio is not None and mode is not None and int(gpio, 0) in self.output_gpios and int(mode, 0) == 1:
+                self.set_output_gpios.add(int(gpio, 0))
+
+    def parse_gpio_writes(self, block_items):
+        ## returns None or list(tuple(int gpio, int level)), the statements "gpioWrite(gpio, level);" with constant
+        ## output GPIOs (each once, set to output mode before in the same function, see set_output_gpio())
+        ## and levels 0 or 1 at the start of block_items, if BS1/BC1 and BS2/BC2 write them with fewer instructions
+        func_sym = self.find_symbol('gpioWrite', filter=FunctionSymbol)
+        if not self.output_gpios or func_sym is None or not isinstance(func_sym.function, VmApiFunction):
+            return None
+        gpio_writes = []
+        for statement_node in block_items:
+            if not isinstance(statement_node, c_ast.FuncCall) or not isinstance(statement_node.name, c_ast.ID) or \
+                    statement_node.name.name != 'gpioWrite' or statement_node.args is None or \
+                    len(statement_node.args.exprs) != 2:
+                break
+            gpio, level = [self.try_parse_constant(arg_node) for arg_node in statement_node.args.exprs]
+            if gpio is None or level is None:
+                break
+            gpio, level = int(gpio, 0), int(level, 0)
+            if gpio not in self.set_output_gpios or not 0 <= gpio <= 53 or level not in (0, 1) or \
+                    any(gpio == prev_gpio for prev_gpio, prev_level in gpio_writes):
+                break
+            gpio_writes.append((gpio, level))
+        if len(self.gpio_bank_masks(gpio_writes)) >= len(gpio_writes):
+            return None
+        return gpio_writes
+
+    @staticmethod
+    def gpio_bank_masks(gpio_writes):
+        ## returns dict(str instr: int bits), BS1/BC1 (GPIOs 0 ... 31) and BS2/BC2 (32 ... 53) bit masks of
+        ## gpio_writes in the order of their first write
+        bank_masks = {}
+        for gpio, level in gpio_writes:
+            instr = ('BS' if level else 'BC') + ('1' if gpio < 32 else '2')
+            bank_masks[instr] = bank_masks.get(instr, 0) | (1 << (gpio % 32))
+        return bank_masks
+
+    def compile_gpio_writes(self, gpio_writes, node):
+        ## merged gpioWrite() statements, whose return values are unused: levels of the same bank change at once
+        for instr, bits in self.gpio_bank_masks(gpio_writes).items():
+            self.asm_out(instr, str(AstConstantFolder.int32(bits)), comment=f'{len(gpio_writes)} x gpioWrite();')
+            self.asm_out.stmt_buf[-1].coord = node.coord
+        self.asm_out.set_flag_coherent()                ## A := status; F := A
+
+    def compile_case_dispatch(self, cases, lo, hi, default_tag, tag_budget, f_value=None):
+        ## GOTO the tag of the case value in A or GOTO default_tag, A is known to be in range lo ... hi
+        ## (None: unbounded), sparse cases use a binary search down to short CMP/JZ ladders
+        ## cases: list(tuple(int value, AsmTag case_tag)), sorted by value
+        ## f_value: None or int, F == A - f_value
+        ## returns int, number of tags left in tag_budget
+        if len(cases) >= SWITCH_TREE_MIN_CASES and tag_budget > 0:
+            pivot, pivot_tag = cases[len(cases) // 2]
+            lower_tag = AsmTag()
+            self.asm_out('CMP', str(pivot))                 ## F := A - pivot
+            self.asm_out('JM', lower_tag)                   ## IF (A < pivot) GOTO lower_tag
+            tag_budget = self.compile_case_dispatch(cases[len(cases) // 2:], pivot, hi, default_tag,
+                tag_budget - 1, pivot)
+            self.asm_out('TAG', lower_tag)                  ## TAG: lower_tag
+            return self.compile_case_dispatch(cases[:len(cases) // 2], lo, pivot - 1, default_tag, tag_budget)
+        for value, case_tag in cases:
+            if value == lo and value == hi:                 ## A can only be value
+                self.asm_out('JMP', case_tag)               ## GOTO case_tag
+                return tag_budget
+            if value != f_value:
+                self.asm_out('CMP', str(value))             ## F := A - value
+            self.asm_out('JZ', case_tag)                    ## IF (A == value) GOTO case_tag
+            if value == lo:
+                lo += 1
+        if lo is None or hi is None or lo <= hi:
+            self.asm_out('JMP', default_tag)                ## GOTO default_tag
+        return tag_budget
+
     def _compile_Compound_node(self, node):
         returned = False
         if node.block_items is not None:
             self.push_scope()
             try:
-                in_unreachable_code = False
-                for statement_node in node.block_items:
-                    if in_unreachable_code:
-                        self.log.warning(statement_node, 'unreachable code', self.context_function)
-                        break
-                    try:
-                        s_returned = self.compile_statement(statement_node)
-                        if s_returned:
-                            returned = True
-                        if s_returned or isinstance(statement_node, (c_ast.Continue, c_ast.Break)):
-                            in_unreachable_code = True
-                    except PccError as e:
-                        self.log.error(e, context_function=self.context_function)
+                returned = self.compile_block_items(node.block_items)
             finally:
                 self.pop_scope()
         return returned
@@ -961,7 +3290,8 @@ class AstCompiler:
         return True
 
     def _compile_Decl_node(self, node):
-        if len(node.align) != 0 or node.bitsize is not None or len(node.funcspec) != 0:
+        if len(node.align) != 0 or node.bitsize is not None or \
+                not (len(node.funcspec) == 0 or (node.funcspec == ['inline'] and isinstance(node.type, c_ast.FuncDecl))):
             raise PccError(node, 'unsupported declaration syntax')
         is_extern = False
         if len(node.storage) > 0:
@@ -990,7 +3320,11 @@ class AstCompiler:
             if node.init is not None:
                 self.compile_assignment(var_sym.asm_repr(), node.init)
         elif isinstance(decl_type, c_ast.FuncDecl):
-            self.declare_function(node, is_vm_function=is_extern)
+            func_sym = self.declare_function(node, is_vm_function=is_extern)
+            if 'inline' in node.funcspec:
+                if is_extern:
+                    raise PccError(node, 'unsupported "inline" for VM API function')
+                func_sym.function.is_inline = True
         elif isinstance(decl_type, c_ast.Enum):
             self.declare_enum(decl_type)
         else:
@@ -1003,9 +3337,12 @@ class AstCompiler:
         if function.impl_node is not None:
             raise PccError(node, f'redefinition of "{function.func_name}"')
         function.impl_node = node
+        if 'inline' in node.decl.funcspec:
+            function.is_inline = True
         ## enter function context
         self.context_function = function
         self.asm_out = function.asm_buf
+        self.set_output_gpios = set()
         self.push_scope()
         try:
             if function.func_name != 'main':
@@ -1060,26 +3397,35 @@ class AstCompiler:
                 asm_args.append(arg_term)
             asm_instr = func_sym.asm_repr()
             self.asm_out(asm_instr, *asm_args, comment=f'{func_name}();')           ## A := vm_api_func(); F := A
+            self.asm_out.set_flag_coherent()
             if asm_instr == 'HALT':
                 returned = True
         else:                                                                       ## compile call to user defined function
             if function is not self.context_function:
                 function.caller.add(self.context_function.func_name)
-            for i_arg, arg_expr_node in enumerate(arg_exprs):
-                self.compile_assignment(function.arg_vars[i_arg], arg_expr_node)
+            prev_in_expression = self.in_expression
+            self.in_expression = False                  ## argument values are not needed in ACC
+            try:
+                for i_arg in self.argument_order(function, arg_exprs):
+                    self.compile_assignment(function.arg_vars[i_arg], arg_exprs[i_arg])
+            finally:
+                self.in_expression = prev_in_expression
             self.asm_out('CALL', func_sym.asm_repr(), comment=f'{func_name}();')    ## A := user_func(); F := undef/A (CIS/EIS)
         return returned
 
     def _compile_If_node(self, node):
+        ## the else-branch falls through to endif_tag, the if-branch JMPs there, if the profile shows the
+        ## if-branch to run more often, the code of the branches is swapped
+        if node.iffalse is not None:
+            true_count, false_count = self.profile_count(node.iftrue), self.profile_count(node.iffalse)
+            if true_count is not None and false_count is not None and true_count > false_count:
+                return self.compile_swapped_if(node)
         else_tag = AsmTag() if node.iffalse is not None else None
         endif_tag = AsmTag()
-        self.compile_expression(node.cond)                  ## A := (cond); F := undef/A (CIS/EIS)
-        if self.use_cis:
-            self.asm_out('OR', 0, comment='F=A')            ## CIS: assert F := A before conditional jump
         if else_tag is None:
-            self.asm_out('JZ', endif_tag)                   ## NOT A AND no-else-branch: GOTO endif_tag
+            self.compile_branch(node.cond, endif_tag, False)    ## NOT cond AND no-else-branch: GOTO endif_tag
         else:
-            self.asm_out('JZ', else_tag)                    ## NOT A AND has-else-branch: GOTO else_tag
+            self.compile_branch(node.cond, else_tag, False)     ## NOT cond AND has-else-branch: GOTO else_tag
         r1 = self.compile_statement(node.iftrue)            ## compile if-branch statement(s)
         r2 = False
         if else_tag is not None:
@@ -1090,18 +3436,48 @@ class AstCompiler:
         self.asm_out('TAG', endif_tag)                      ## TAG: endif_tag
         return r1 and r2
 
+    def compile_swapped_if(self, node):
+        then_tag = AsmTag()
+        endif_tag = AsmTag()
+        self.compile_branch(node.cond, then_tag, True)      ## cond: GOTO then_tag
+        r2 = self.compile_statement(node.iffalse)           ## compile else-branch
+        if not r2:                                          ## omit the following JMP when else-branch returned (RET)
+            self.asm_out('JMP', endif_tag)                  ## GOTO endif_tag
+        self.asm_out('TAG', then_tag)                       ## TAG: then_tag
+        r1 = self.compile_statement(node.iftrue)            ## compile if-branch statement(s)
+        self.asm_out('TAG', endif_tag)                      ## TAG: endif_tag
+        return r1 and r2
+
+    def profile_count(self, node):
+        ## returns None or int, profiled execution count of the code of statement node (of its first statement)
+        if self.profile is None:
+            return None
+        while isinstance(node, c_ast.Compound) and node.block_items:
+            items = [item for item in node.block_items if not isinstance(item, (c_ast.Pragma, c_ast.EmptyStatement))
+                and not (isinstance(item, c_ast.Decl) and item.init is None)]
+            if len(items) == 0:
+                break
+            node = items[0]
+        if node.coord is None:
+            return None
+        filename, row = self.c_sources.map_coord(node.coord.line)
+        return self.profile.line_count(filename, row)
+
     def _compile_While_node(self, node):
-        begin_tag = AsmTag()
+        ## rotated loop, tests the condition once per iteration at the bottom
+        body_tag = AsmTag()
+        test_tag = AsmTag()
         end_tag = AsmTag()
-        self.push_loop_tags(begin_tag, end_tag)
+        self.name_loop(node, 'while', body_tag)
+        with self.timed('hoist'):
+            self.hoist_loop_invariants(node)                ## compile preheader
+        self.push_loop_tags(test_tag, end_tag)
         try:
-            self.asm_out('TAG', begin_tag)                  ## TAG: begin_tag
-            self.compile_expression(node.cond)              ## A := (cond); F := undef/A (CIS/EIS)
-            if self.use_cis:
-                self.asm_out('OR', 0, comment='F=A')        ## CIS: assert F := A before conditional jump
-            self.asm_out('JZ', end_tag)                     ## cond == FALSE: GOTO end_tag
+            self.asm_out('JMP', test_tag)                   ## GOTO test_tag
+            self.asm_out('TAG', body_tag)                   ## TAG: body_tag
             returned = self.compile_statement(node.stmt)    ## compile statement(s)
-            self.asm_out('JMP', begin_tag)                  ## GOTO begin_tag
+            self.asm_out('TAG', test_tag)                   ## TAG: test_tag
+            self.compile_branch(node.cond, body_tag, True)  ## cond == TRUE: GOTO body_tag
             self.asm_out('TAG', end_tag)                    ## TAG: end_tag
         finally:
             self.pop_loop_tags()
@@ -1109,52 +3485,282 @@ class AstCompiler:
 
     def _compile_DoWhile_node(self, node):
         begin_tag = AsmTag()
+        next_tag = AsmTag()
         end_tag = AsmTag()
-        self.push_loop_tags(begin_tag, end_tag)
+        self.name_loop(node, 'do', begin_tag)
+        with self.timed('hoist'):
+            self.hoist_loop_invariants(node)                ## compile preheader
+        self.push_loop_tags(next_tag, end_tag)
         try:
             self.asm_out('TAG', begin_tag)                  ## TAG: begin_tag
             returned = self.compile_statement(node.stmt)    ## compile statement(s)
-            self.compile_expression(node.cond)              ## A := (cond); F := undef/A (CIS/EIS)
-            if self.use_cis:
-                self.asm_out('OR', 0, comment='F=A')        ## CIS: assert F := A before conditional jump
-            self.asm_out('JNZ', begin_tag)                  ## cond == TRUE: GOTO begin_tag
+            self.asm_out('TAG', next_tag)                   ## TAG: next_tag
+            self.compile_branch(node.cond, begin_tag, True) ## cond == TRUE: GOTO begin_tag
             self.asm_out('TAG', end_tag)                    ## TAG: end_tag
         finally:
             self.pop_loop_tags()
         return returned
 
     def _compile_For_node(self, node):
-        begin_tag = AsmTag()
+        ## for loops with a constant trip count are unrolled fully if "#pragma unroll" requests it or if the
+        ## unrolled code stays within unroll_growth of the loop, "#pragma unroll N" unrolls by a factor of N
+        ## profiled loops: bodies never executed stay rolled, hot ones may grow as much as at -O2
+        unroll_hint, self.unroll_hint = self.unroll_hint, None
+        unroll_growth = self.unroll_growth
+        body_count = self.profile_count(node.stmt) if unroll_hint is None and unroll_growth is not None else None
+        if body_count == 0:
+            unroll_growth = None
+        elif body_count is not None and body_count >= PROFILE_HOT_COUNT:
+            unroll_growth = tuple(max(growth) for growth in zip(unroll_growth,
+                (UNROLL_MAX_STMT_GROWTH, UNROLL_MAX_TAG_GROWTH)))
+        if unroll_hint == 1 or (unroll_hint is None and unroll_growth is None):
+            return self.compile_for_loop(node)
+        with self.timed('unroll'):
+            counting_loop = self.parse_counting_loop(node)
+            if counting_loop is None:
+                if unroll_hint is not None:
+                    self.log.warning(node, 'loop not unrolled, expects a constant trip count', self.context_function)
+                return self.compile_for_loop(node)
+            if unroll_hint is not None and unroll_hint > 1 and unroll_hint < len(counting_loop[1]):
+                return self.compile_statement(self.unroll_partially(node, counting_loop, unroll_hint))
+            unrolled_buf, unrolled_returned, is_clean = self.compile_scratch(self.unroll_fully(node, counting_loop), True)
+            unrolled_size = unrolled_buf.count_statements()
+            if unroll_hint is None:
+                self.unroll_hint = 1
+                rolled_buf, rolled_returned, _ = self.compile_scratch(node)
+                rolled_size = rolled_buf.count_statements()
+                if not is_clean or any(unrolled_size[i] > rolled_size[i] + unroll_growth[i] for i in range(2)):
+                    self.asm_out.append_buffer(rolled_buf)
+                    return rolled_returned
+            elif not is_clean or unrolled_size[0] > INLINE_MAX_STMT_COUNT or unrolled_size[1] > VM_MAX_TAGS:
+                self.log.warning(node, 'loop not unrolled, unrolled code exceeds the VM limits', self.context_function)
+                self.unroll_hint = 1
+                return self.compile_statement(node)
+            self.asm_out.append_buffer(unrolled_buf)
+            return unrolled_returned
+
+    def parse_counting_loop(self, node):
+        ## returns None or tuple(str ind_cname, list(int) ind_values, int final_value), induction variable
+        ## of a for loop with constant init, bound and step whose body never writes it, its value in
+        ## each iteration and its value after the loop
+        init_node = node.init
+        if isinstance(init_node, c_ast.DeclList) and len(init_node.decls) == 1:
+            init_node = init_node.decls[0]
+            if init_node.init is None:
+                return None
+            ind_cname, init_value = init_node.name, self.try_parse_constant(init_node.init)
+        elif isinstance(init_node, c_ast.Assignment) and init_node.op == '=' and isinstance(init_node.lvalue, c_ast.ID):
+            ind_cname, init_value = init_node.lvalue.name, self.try_parse_constant(init_node.rvalue)
+            ind_sym = self.find_symbol(ind_cname, filter=VmVariableSymbol)
+            if ind_sym is None or ind_sym.context_function is None:
+                return None                 ## user-defined functions in the body may read global variables
+        else:
+            return None
+        ## parse condition "i <OP> bound" or "bound <OP> i"
+        cond_node = node.cond
+        if not isinstance(cond_node, c_ast.BinaryOp) or cond_node.op not in self.NEGATED_COMPARISON:
+            return None
+        cmp_op, bound = cond_node.op, None
+        if isinstance(cond_node.left, c_ast.ID) and cond_node.left.name == ind_cname:
+            bound = self.try_parse_constant(cond_node.right)
+        elif isinstance(cond_node.right, c_ast.ID) and cond_node.right.name == ind_cname:
+            cmp_op, bound = self.SWAPPED_COMPARISON[cmp_op], self.try_parse_constant(cond_node.left)
+        ## parse iteration expression "i++", "++i", "i--", "--i", "i += step" or "i -= step"
+        next_node, step = node.next, None
+        if isinstance(next_node, c_ast.UnaryOp) and isinstance(next_node.expr, c_ast.ID) and \
+                next_node.expr.name == ind_cname:
+            step = {'++': '1', 'p++': '1', '--': '-1', 'p--': '-1'}.get(next_node.op, None)
+        elif isinstance(next_node, c_ast.Assignment) and next_node.op in ('+=', '-=') and \
+                isinstance(next_node.lvalue, c_ast.ID) and next_node.lvalue.name == ind_cname:
+            step = self.try_parse_constant(next_node.rvalue)
+            if step is not None and next_node.op == '-=':
+                step = str(-int(step, 0))
+        if init_value is None or bound is None or step is None or \
+                not self.is_unrollable_body(node.stmt, ind_cname):
+            return None
+        ## simulate the induction variable
+        ind_value, bound, step = int(init_value, 0), int(bound, 0), int(step, 0)
+        ind_values = []
+        while AstConstantFolder.eval_binary_op(cmp_op, ind_value, bound):
+            if len(ind_values) == UNROLL_MAX_TRIP_COUNT:
+                return None
+            ind_values.append(ind_value)
+            ind_value = AstConstantFolder.int32(ind_value + step)
+        return ind_cname, ind_values, ind_value
+
+    def is_unrollable_body(self, node, ind_cname, loop_exits=(c_ast.Break, c_ast.Continue)):
+        ## returns bool, True if loop body node neither writes nor redeclares the induction variable, nor
+        ## contains asm() statements or "break" and "continue" statements leaving the loop itself
+        ## loop_exits: tuple(class), jump statements that leave the loop at this nesting level
+        if isinstance(node, (c_ast.Break, c_ast.Continue)):
+            return not isinstance(node, loop_exits)
+        elif isinstance(node, c_ast.Decl):
+            if node.name == ind_cname:
+                return False
+        elif isinstance(node, c_ast.Assignment):
+            if isinstance(node.lvalue, c_ast.ID) and node.lvalue.name == ind_cname:
+                return False
+        elif isinstance(node, c_ast.UnaryOp) and node.op in ('++', '--', 'p++', 'p--'):
+            if isinstance(node.expr, c_ast.ID) and node.expr.name == ind_cname:
+                return False
+        elif isinstance(node, c_ast.FuncCall):
+            if isinstance(node.name, c_ast.ID) and node.name.name == 'asm':
+                return False
+        elif isinstance(node, (c_ast.While, c_ast.DoWhile, c_ast.For)):
+            loop_exits = ()
+        elif isinstance(node, c_ast.Switch):
+            loop_exits = tuple(exit_class for exit_class in loop_exits if exit_class is not c_ast.Break)
+        return all(self.is_unrollable_body(child_node, ind_cname, loop_exits) for child_name, child_node in node.children())
+
+    def unroll_fully(self, node, counting_loop):
+        ## returns c_ast.Compound, a copy of the body of for loop node per iteration with the induction
+        ## variable replaced by its value, followed by the assignment of its final value
+        ind_cname, ind_values, final_value = counting_loop
+        folder_names = self.folder_names()
+        block_items = [self.copy_loop_body(node.stmt, ind_cname, self.int_node(ind_value, node.coord), folder_names)
+            for ind_value in ind_values]
+        if not isinstance(node.init, c_ast.DeclList):
+            block_items.append(c_ast.Assignment('=', c_ast.ID(ind_cname, coord=node.coord),
+                self.int_node(final_value, node.coord), coord=node.coord))
+        return c_ast.Compound(block_items, coord=node.coord)
+
+    def unroll_partially(self, node, counting_loop, factor):
+        ## returns c_ast.Compound, the first iterations of for loop node up to a multiple of factor unrolled
+        ## fully, followed by a for loop over factor copies of the body with the induction variable i
+        ## replaced by "i + k * step", which tests the condition once per factor iterations
+        ind_cname, ind_values, final_value = counting_loop
+        coord = node.coord
+        step = AstConstantFolder.int32(ind_values[1] - ind_values[0])
+        n_peeled = len(ind_values) % factor
+        folder_names = self.folder_names()
+        block_items = [self.copy_loop_body(node.stmt, ind_cname, self.int_node(ind_value, coord), folder_names)
+            for ind_value in ind_values[:n_peeled]]
+        loop_body_items = []
+        for k in range(factor):
+            ind_node = c_ast.ID(ind_cname, coord=coord)
+            if k > 0:
+                ind_node = c_ast.BinaryOp('+', ind_node, self.int_node(k * step, coord), coord=coord)
+            loop_body_items.append(self.copy_loop_body(node.stmt, ind_cname, ind_node, folder_names))
+        init_node = copy.deepcopy(node.init)
+        if isinstance(init_node, c_ast.DeclList):
+            init_node.decls[0].init = self.int_node(ind_values[n_peeled], coord)
+        else:
+            init_node.rvalue = self.int_node(ind_values[n_peeled], coord)
+        next_node = c_ast.Assignment('+=', c_ast.ID(ind_cname, coord=coord), self.int_node(factor * step, coord),
+            coord=coord)
+        block_items.append(c_ast.Pragma('unroll 1', coord=coord))  ## the remaining loop is not unrolled again
+        block_items.append(c_ast.For(init_node, node.cond, next_node, c_ast.Compound(loop_body_items, coord=coord),
+            coord=coord))
+        return c_ast.Compound(block_items, coord=coord)
+
+    def copy_loop_body(self, stmt_node, ind_cname, ind_node, folder_names):
+        ## returns c_ast.Compound, copy of loop body stmt_node with the induction variable replaced by
+        ## expression ind_node and constant sub-expressions folded
+        body_node = c_ast.Compound([copy.deepcopy(stmt_node)], coord=stmt_node.coord)
+        self._substitute_id(body_node, ind_cname, ind_node)
+        AstConstantFolder(folder_names).fold(body_node)
+        if self.call_evaluator is not None:
+            while self.call_evaluator.evaluate_calls(body_node) > 0:
+                AstConstantFolder(folder_names).fold(body_node)
+        return body_node
+
+    def _substitute_id(self, node, cname, new_node):
+        for child_name, child_node in node.children():
+            if isinstance(child_node, c_ast.ID) and child_node.name == cname and \
+                    not (isinstance(node, c_ast.FuncCall) and child_name == 'name'):
+                AstConstantFolder._replace_child(node, child_name, copy.deepcopy(new_node))
+            else:
+                self._substitute_id(child_node, cname, new_node)
+
+    @staticmethod
+    def int_node(value, coord):
+        ## returns c_ast node of int constant value
+        if value < 0:
+            return c_ast.UnaryOp('-', c_ast.Constant('int', str(-value), coord=coord), coord=coord)
+        return c_ast.Constant('int', str(value), coord=coord)
+
+    def folder_names(self):
+        ## returns dict(str cname: int or AstConstantFolder.OPAQUE), names in scope for AstConstantFolder
+        return {cname: AstConstantFolder.int32(AstConstantFolder.parse_int(symbol.const_value))
+            if isinstance(symbol, EnumSymbol) else AstConstantFolder.OPAQUE for cname, symbol in self.scope.items()}
+
+    def compile_scratch(self, node, muted=False):
+        ## returns tuple(AsmBuffer asm_buf, bool returned, bool is_clean), statement node compiled into a
+        ## new buffer continuing the current one, is_clean: False if compiling node logged diagnostics,
+        ## which are discarded if muted
+        asm_out = self.asm_out
+        self.asm_out = AsmBuffer()
+        self.asm_out.flag_state = asm_out.flag_state
+        log_state = (self.log.file, self.log.error_count, self.log.e_location)
+        if muted:
+            self.log.file = io.StringIO()
+        try:
+            returned = self.compile_statement(node)
+            is_clean = not muted or self.log.file.getvalue() == ''
+        except PccError:
+            if not muted:
+                raise
+            returned, is_clean = False, False
+        finally:
+            asm_buf, self.asm_out = self.asm_out, asm_out
+            if muted:
+                self.log.file, self.log.error_count, self.log.e_location = log_state
+        return asm_buf, returned, is_clean
+
+    def compile_for_loop(self, node):
+        ## rotated loop, tests the condition once per iteration at the bottom, counting loops (see
+        ## parse_loop_counter()) test the flags of the INR or DCR of the iteration expression instead and
+        ## guard the entry by a separate test, which is omitted if the first iteration is certain
+        body_tag = AsmTag()
         next_tag = AsmTag()
+        test_tag = AsmTag()
         end_tag = AsmTag()
+        self.name_loop(node, 'for', body_tag)
+        counter = None
+        if self.count_loops:
+            with self.timed('count-loops'):
+                counter = self.parse_loop_counter(node)
+        init_node, cond_node = node.init, node.cond
+        if counter is not None:
+            ind_cname, offset, init_node, entry_cond = counter
+            coord = node.cond.coord
+            cond_node = c_ast.BinaryOp('!=', c_ast.ID(ind_cname, coord=coord), self.int_node(0, coord), coord=coord)
         self.push_loop_tags(next_tag, end_tag)
         try:
-            needs_local_scope = node.init is not None and isinstance(node.init, c_ast.DeclList)
+            needs_local_scope = init_node is not None and isinstance(init_node, c_ast.DeclList)
             if needs_local_scope:
                 self.push_scope()
             try:
-                if node.init is not None:                       ## compile init-clause statement(s)
-                    if isinstance(node.init, c_ast.DeclList):
-                        for decl_node in node.init.decls:
+                if init_node is not None:                       ## compile init-clause statement(s)
+                    if isinstance(init_node, c_ast.DeclList):
+                        for decl_node in init_node.decls:
                             self._compile_Decl_node(decl_node)
                     else:
-                        self.compile_statement(node.init)
-                self.asm_out('TAG', begin_tag)                  ## TAG: begin_tag
-                if node.cond is not None:
-                    self.compile_expression(node.cond)          ## A := (cond); F := undef/A (CIS/EIS)
-                    if self.use_cis:
-                        self.asm_out('OR', 0, comment='F=A')    ## CIS: assert F := A before conditional jump
-                    self.asm_out('JZ', end_tag)                 ## cond == FALSE: GOTO end_tag
+                        self.compile_statement(init_node)
+                with self.timed('hoist'):
+                    self.hoist_loop_invariants(node)            ## compile preheader
+                if counter is not None:
+                    if entry_cond is not None:
+                        self.compile_branch(entry_cond, end_tag, False) ## cond == FALSE: GOTO end_tag
+                elif cond_node is not None:
+                    self.asm_out('JMP', test_tag)               ## GOTO test_tag
+                self.asm_out('TAG', body_tag)                   ## TAG: body_tag
                 returned = self.compile_statement(node.stmt)    ## compile loop-body statement(s)
                 self.asm_out('TAG', next_tag)                   ## TAG: next_tag
-                if node.next is not None:                       ## compile iteration-expression(s)
-                    if isinstance(node.next, c_ast.ExprList):
-                        for expr_node in node.next.exprs:
-                            self.compile_expression(expr_node)  ## A := (next-expr); F := undef/A (CIS/EIS)
-                    else:
-                        self.compile_expression(node.next)      ## A := (next-expr); F := undef/A (CIS/EIS)
-                self.asm_out('JMP', begin_tag)                  ## GOTO begin_tag
+                if node.next is not None:                       ## compile iteration-expression(s), values unused
+                    for expr_node in node.next.exprs if isinstance(node.next, c_ast.ExprList) else [node.next]:
+                        if self.try_parse_term(expr_node) is None:
+                            self.compile_statement(expr_node)
+                if counter is None:
+                    self.asm_out('TAG', test_tag)               ## TAG: test_tag
+                if cond_node is not None:
+                    self.compile_branch(cond_node, body_tag, True) ## cond == TRUE: GOTO body_tag
+                else:
+                    self.asm_out('JMP', body_tag)               ## GOTO body_tag
                 self.asm_out('TAG', end_tag)                    ## TAG: end_tag
+                if counter is not None and offset != 0 and not needs_local_scope:
+                    ind_reg = self.find_symbol(ind_cname, filter=VariableSymbol).asm_repr()
+                    self.compile_assignment(ind_reg, self.int_node(offset, coord), '+=') ## i := (i - offset) + offset
             finally:
                 if needs_local_scope:
                     self.pop_scope()
@@ -1162,6 +3768,158 @@ class AstCompiler:
             self.pop_loop_tags()
         return returned
 
+    def parse_loop_counter(self, node):
+        ## returns None or tuple(str ind_cname, int offset, c_ast.Node init_node, None or c_ast.Node entry_cond),
+        ## for loop node whose iteration expression increments or decrements induction variable i by 1 toward
+        ## a constant bound of its condition: the loop ends when i reaches stop value offset, it keeps i - offset
+        ## in i so that "i != 0" tests the flags of the INR or DCR, init_node: init-clause of i - offset,
+        ## entry_cond: condition before the first iteration (None: it holds), the body must not write i,
+        ## offsets other than 0 expect a body not reading i
+        next_node, cond_node = node.next, node.cond
+        if not isinstance(next_node, c_ast.UnaryOp) or next_node.op not in ('++', 'p++', '--', 'p--') or \
+                not isinstance(next_node.expr, c_ast.ID):
+            return None
+        ind_cname, step = next_node.expr.name, 1 if next_node.op in ('++', 'p++') else -1
+        ## the body must neither write nor redeclare i, called user-defined functions may write a global i
+        written_cnames, declared_cnames = set(), set()
+        if not self.collect_loop_writes(node.stmt, written_cnames, declared_cnames) or \
+                ind_cname in written_cnames or ind_cname in declared_cnames:
+            return None
+        ind_sym = self.find_symbol(ind_cname, filter=VmVariableSymbol)
+        is_local = (ind_sym is not None and ind_sym.context_function is not None) or \
+            (isinstance(node.init, c_ast.DeclList) and any(decl.name == ind_cname for decl in node.init.decls))
+        if None in written_cnames and not is_local:
+            return None
+        ## parse condition "i", "i <OP> bound" or "bound <OP> i"
+        bound = None
+        if isinstance(cond_node, c_ast.ID) and cond_node.name == ind_cname:
+            cmp_op, bound = '!=', '0'
+        elif isinstance(cond_node, c_ast.BinaryOp) and cond_node.op in self.LOOP_COUNTER_STOP:
+            if isinstance(cond_node.left, c_ast.ID) and cond_node.left.name == ind_cname:
+                cmp_op, bound = cond_node.op, self.try_parse_constant(cond_node.right)
+            elif isinstance(cond_node.right, c_ast.ID) and cond_node.right.name == ind_cname:
+                cmp_op, bound = self.SWAPPED_COMPARISON[cond_node.op], self.try_parse_constant(cond_node.left)
+        if bound is None or cmp_op not in self.LOOP_COUNTER_STOP:
+            return None
+        bound = int(bound, 0)
+        cmp_step, delta = self.LOOP_COUNTER_STOP[cmp_op]
+        offset = bound + delta
+        if (cmp_step is not None and cmp_step != step) or not -0x80000000 <= offset <= 0x7fffffff:
+            return None
+        ## parse init-clause "i = init" or "int i = init"
+        init_node, init_expr = node.init, None
+        if isinstance(init_node, c_ast.DeclList) and len(init_node.decls) == 1 and init_node.decls[0].name == ind_cname:
+            init_expr = init_node.decls[0].init
+        elif isinstance(init_node, c_ast.Assignment) and init_node.op == '=' and \
+                isinstance(init_node.lvalue, c_ast.ID) and init_node.lvalue.name == ind_cname:
+            if is_local:
+                init_expr = init_node.rvalue    ## user-defined functions in the body may read global variables
+        init_value = self.try_parse_constant(init_expr) if init_expr is not None else None
+        init_value = int(init_value, 0) if init_value is not None else None
+        ## rebase i to i - offset if the body doesn't read i and neither rebasing nor counting overflows
+        if offset != 0:
+            if init_expr is None or self.reads_variable(node.stmt, ind_cname):
+                return None
+            if init_value is not None:
+                if not -0x80000000 <= init_value - offset <= 0x7fffffff or (offset - init_value) * step < 0:
+                    return None
+            elif cmp_op == '!=' or offset < 0 or not self.is_non_negative(init_expr):
+                return None
+            coord = init_expr.coord
+            if init_value is not None:
+                rebased_expr = self.int_node(init_value - offset, coord)
+            else:
+                rebased_expr = c_ast.BinaryOp('-', init_expr, self.int_node(offset, coord), coord=coord)
+            if isinstance(init_node, c_ast.DeclList):
+                decl_node = copy.copy(init_node.decls[0])
+                decl_node.init = rebased_expr
+                init_node = c_ast.DeclList([decl_node], coord=init_node.coord)
+            else:
+                init_node = c_ast.Assignment('=', init_node.lvalue, rebased_expr, coord=init_node.coord)
+        entry_cond = None
+        if init_value is None or not AstConstantFolder.eval_binary_op(cmp_op, init_value, bound):
+            coord = cond_node.coord
+            entry_cond = c_ast.BinaryOp(cmp_op, c_ast.ID(ind_cname, coord=coord), self.int_node(bound - offset, coord),
+                coord=coord)
+        return ind_cname, offset, init_node, entry_cond
+
+    def reads_variable(self, node, cname):
+        ## returns bool, True if node may read variable cname: it names cname or contains an asm() statement
+        if isinstance(node, c_ast.ID):
+            return node.name == cname
+        if isinstance(node, c_ast.FuncCall) and isinstance(node.name, c_ast.ID):
+            if node.name.name == 'asm':
+                return True
+            return node.args is not None and self.reads_variable(node.args, cname)
+        return any(self.reads_variable(child_node, cname) for child_name, child_node in node.children())
+
+    def _compile_Switch_node(self, node):
+        ## collect case labels: each label starts a group of statements, empty groups share their tag
+        ## with the following group, execution falls through from group to group
+        block_items = node.stmt.block_items if isinstance(node.stmt, c_ast.Compound) else [node.stmt]
+        groups = []                                         ## list(tuple(AsmTag group_tag, list(c_ast.Node) stmts))
+        cases = {}                                          ## dict(int value: AsmTag group_tag)
+        default_tag = None
+        end_tag = AsmTag()
+        group_tag = None
+        for item_node in block_items or []:
+            if not isinstance(item_node, (c_ast.Case, c_ast.Default)):
+                raise PccError(item_node, 'statement before first "case" label not supported')
+            if group_tag is None:
+                group_tag = AsmTag()
+            if isinstance(item_node, c_ast.Default):
+                if default_tag is not None:
+                    raise PccError(item_node, 'multiple "default" labels in one switch')
+                default_tag = group_tag
+            else:
+                const_value = self.try_parse_constant(item_node.expr)
+                if const_value is None:
+                    raise PccError(item_node.expr, 'case label expects an integer constant expression')
+                value = AstConstantFolder.int32(int(const_value, 0))
+                if value in cases:
+                    raise PccError(item_node.expr, f'duplicate case value {value}')
+                cases[value] = group_tag
+            if len(item_node.stmts) > 0:
+                groups.append((group_tag, item_node.stmts))
+                group_tag = None
+        if group_tag is not None:                           ## trailing labels without statements
+            groups.append((group_tag, []))
+        if default_tag is None:
+            default_tag = end_tag
+        ## dispatch on the switch value in A, dense case values get a range check first, so that
+        ## the binary search knows the bounds and can omit comparisons, case values 2^31 or more apart
+        ## take a CMP/JZ ladder, as "CMP pivot" would overflow
+        self.compile_expression(node.cond)                  ## A := (cond-expr)
+        sorted_cases = sorted(cases.items())
+        lo = hi = None
+        tag_budget = SWITCH_TREE_MAX_TAGS if len(cases) == 0 or \
+            sorted_cases[-1][0] - sorted_cases[0][0] < 0x80000000 else 0
+        if len(sorted_cases) >= SWITCH_TREE_MIN_CASES and \
+                sorted_cases[-1][0] - sorted_cases[0][0] < 2 * len(sorted_cases) and sorted_cases[-1][0] < 0x7fffffff:
+            lo, hi = sorted_cases[0][0], sorted_cases[-1][0]
+            self.asm_out('CMP', str(lo))                    ## F := A - lo
+            self.asm_out('JM', default_tag)                 ## IF (A < lo) GOTO default_tag
+            self.asm_out('CMP', str(hi + 1))                ## F := A - (hi + 1)
+            self.asm_out('JP', default_tag)                 ## IF (A > hi) GOTO default_tag
+        self.compile_case_dispatch(sorted_cases, lo, hi, default_tag, tag_budget)
+        ## compile statement groups, "break" jumps to end_tag
+        i_first_stmt = len(self.asm_out.stmt_buf)
+        returned = False
+        self.push_loop_tags(self.loop_continue_tag, end_tag)
+        self.push_scope()
+        try:
+            for group_tag, stmts in groups:
+                self.asm_out('TAG', group_tag)              ## TAG: group_tag
+                returned = self.compile_block_items(stmts)
+        finally:
+            self.pop_scope()
+            self.pop_loop_tags()
+        self.asm_out('TAG', end_tag)                        ## TAG: end_tag
+        ## returned if all paths end in a return: no "break" and no way around the statement groups
+        breaks = any(isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.args[0] is end_tag
+            for asm_stmt in self.asm_out.stmt_buf[i_first_stmt:])
+        return returned and default_tag is not end_tag and not breaks
+
     def _compile_Continue_node(self, node):
         if self.loop_continue_tag is None:
             raise PccError(node, '"continue" outside loop not allowed')
@@ -1170,35 +3928,357 @@ class AstCompiler:
 
     def _compile_Break_node(self, node):
         if self.loop_break_tag is None:
-            raise PccError(node, '"break" outside loop not allowed')
+            raise PccError(node, '"break" outside loop or switch not allowed')
         self.asm_out('JMP', self.loop_break_tag)
         return False
 
     def _compile_EmptyStatement_node(self, node):
         return False
 
+    def _compile_Pragma_node(self, node):
+        ## "#pragma unroll" unrolls the following for loop fully, "#pragma unroll N" by a factor of N
+        m = re.fullmatch(r'\s*unroll(?:\s+([1-9][0-9]*))?\s*', node.string)
+        if m is None:
+            self.log.warning(node, f'ignoring unsupported "#pragma {node.string.strip()}"', self.context_function)
+        elif self.context_function is None:
+            self.log.warning(node, '"#pragma unroll" expects a "for" loop', None)
+        else:
+            self.unroll_hint = int(m[1]) if m[1] is not None else 0
+        return False
+
+## ---------------------------------------------------------------------------
+
+class VmCostModel:
+    DEFAULT_COST = 1                        ## int, default weight of a VM instruction
+    SLOW_COST = 10                          ## int, default weight of slow (bus transfer) instructions
+    SLOW_INSTR = ('I2CO', 'I2CC', 'I2CWQ', 'I2CRS', 'I2CWS', 'I2CRB', 'I2CWB', 'I2CRW', 'I2CWW', 'I2CPC')
+    BLOCKING_INSTR = ('MICS', 'MILS', 'WAIT', 'EVTWT')
+
+    def __init__(self, costs=None, blocking=None):
+        self.costs = {instr: self.SLOW_COST for instr in self.SLOW_INSTR} ## dict(str instr: int cost)
+        if costs is not None:
+            self.costs.update(costs)
+        self.blocking = set(self.BLOCKING_INSTR if blocking is None else blocking) ## set(str instr)
+
+    @classmethod
+    def from_file(cls, filename):
+        ## read cost table from INI file with optional sections "[cost]" (INSTR = int weight)
+        ## and "[blocking]" (INSTR = yes|no), raises OSError, ValueError or configparser.Error
+        config = configparser.ConfigParser()
+        with open(filename) as f:
+            config.read_file(f)
+        costs = {}
+        if config.has_section('cost'):
+            for instr in config['cost']:
+                costs[instr.upper()] = config['cost'].getint(instr)
+        blocking = set(cls.BLOCKING_INSTR)
+        if config.has_section('blocking'):
+            for instr in config['blocking']:
+                if config['blocking'].getboolean(instr):
+                    blocking.add(instr.upper())
+                else:
+                    blocking.discard(instr.upper())
+        return cls(costs, blocking)
+
+    def cost(self, instr):
+        return self.costs.get(instr, self.DEFAULT_COST)
+
+class VmCostReport:
+    class Entry:
+        def __init__(self, kind, name, instr_count, cost, path_cost, blocking_count):
+            self.kind = kind                ## str, "function", "loop" or "helper"
+            self.name = name                ## str, function, loop or emulated instruction name
+            self.instr_count = instr_count  ## int, number of instructions
+            self.cost = cost                ## int, sum of instruction weights
+            self.path_cost = path_cost      ## int, weighted length of the longest path through the code (CALLs included)
+            self.blocking_count = blocking_count ## int, number of blocking instructions
+
+    def __init__(self, cost_model):
+        self.cost_model = cost_model        ## VmCostModel, instruction weights
+        self.entries = []                   ## list(Entry), report entries in output order
+
+    def analyze(self, code_bufs, loop_names):
+        ## code_bufs: list(tuple(str kind, str name, AsmBuffer asm_buf, AsmTag entry_tag)), loop_names: dict(AsmTag: str)
+        self._bufs_by_tag = {entry_tag: asm_buf for kind, name, asm_buf, entry_tag in code_bufs if entry_tag is not None}
+        self._path_memo = {}
+        for kind, name, asm_buf, entry_tag in code_bufs:
+            stmt_buf = asm_buf.stmt_buf
+            self.entries.append(self._entry(kind, name, stmt_buf, 0, len(stmt_buf) - 1))
+            tag_pos = {asm_stmt: i_stmt for i_stmt, asm_stmt in enumerate(stmt_buf) if isinstance(asm_stmt, AsmTag)}
+            loop_ends = {}                  ## dict(int i_head: int i_back_edge), outermost backward jump per loop head
+            for i_stmt, asm_stmt in enumerate(stmt_buf):
+                if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr != 'CALL':
+                    i_head = tag_pos.get(asm_stmt.args[0], i_stmt)
+                    if i_head < i_stmt:
+                        loop_ends[i_head] = i_stmt
+            for i_head, i_end in sorted(loop_ends.items()):
+                loop_name = loop_names.get(stmt_buf[i_head], f'loop at TAG {stmt_buf[i_head]}')
+                self.entries.append(self._entry('loop', f'{name}: {loop_name}', stmt_buf, i_head, i_end))
+
+    def format(self):
+        lines = ['static cost report (cost: sum of instruction weights, path: weighted longest path, loops not iterated)',
+            f'{"kind":<9} {"name":<40} {"instrs":>6} {"cost":>6} {"path":>6} {"blocking":>8}']
+        for entry in self.entries:
+            lines.append(f'{entry.kind:<9} {entry.name:<40} {entry.instr_count:>6} {entry.cost:>6} '
+                f'{entry.path_cost:>6} {entry.blocking_count:>8}')
+        return '\n'.join(lines)
+
+    ## Private functions
+
+    def _entry(self, kind, name, stmt_buf, i_start, i_end):
+        asm_cmds = [asm_stmt for asm_stmt in stmt_buf[i_start:i_end+1] if isinstance(asm_stmt, AsmCmd)]
+        return self.Entry(kind, name, len(asm_cmds), sum(self.cost_model.cost(asm_cmd.instr) for asm_cmd in asm_cmds),
+            self._path_cost(stmt_buf, i_start, i_end), sum(1 for asm_cmd in asm_cmds if asm_cmd.instr in self.cost_model.blocking))
+
+    def _path_cost(self, stmt_buf, i_start, i_end):
+        ## weighted longest path from stmt_buf[i_start] to leaving stmt_buf[i_start:i_end+1], following
+        ## forward jumps only, a CALL adds the longest path through the called function
+        tag_pos = {asm_stmt: i_stmt for i_stmt, asm_stmt in enumerate(stmt_buf) if isinstance(asm_stmt, AsmTag)}
+        path = [0] * (i_end + 2)
+        for i_stmt in range(i_end, i_start - 1, -1):
+            asm_stmt = stmt_buf[i_stmt]
+            if not isinstance(asm_stmt, AsmCmd):
+                path[i_stmt] = path[i_stmt + 1]
+                continue
+            cost = self.cost_model.cost(asm_stmt.instr)
+            succ_paths = []
+            if isinstance(asm_stmt, AsmBranchCmd) and asm_stmt.instr == 'CALL':
+                cost += self._callee_path_cost(asm_stmt.args[0])
+            elif isinstance(asm_stmt, AsmBranchCmd):
+                i_target = tag_pos.get(asm_stmt.args[0], -1)
+                if i_target > i_stmt:
+                    succ_paths.append(path[i_target] if i_target <= i_end else 0)
+            if asm_stmt.instr not in ('JMP', 'RET', 'HALT'):
+                succ_paths.append(path[i_stmt + 1])
+            path[i_stmt] = cost + max(succ_paths, default=0)
+        return path[i_start]
+
+    def _callee_path_cost(self, entry_tag):
+        if entry_tag not in self._path_memo:
+            self._path_memo[entry_tag] = 0  ## recursion guard
+            asm_buf = self._bufs_by_tag.get(entry_tag, None)
+            if asm_buf is not None:
+                self._path_memo[entry_tag] = self._path_cost(asm_buf.stmt_buf, 0, len(asm_buf.stmt_buf) - 1)
+        return self._path_memo[entry_tag]
+
+## ---------------------------------------------------------------------------
+
+class PccProfile:
+    ## execution counts of a profiling run (see pipcc.py --profile), JSON file {"blocks": [{"file": str,
+    ## "line": int, "function": str, "count": int, "entry": bool}, ...]}, one entry per counted basic block
+    def __init__(self, blocks=None):
+        self.blocks = []                    ## list(dict), counted basic blocks in file order
+        self.line_counts = {}               ## dict(tuple(str filename, int row): int count), highest count of blocks starting in row
+        self.func_counts = {}               ## dict(str func_name: int count), number of calls of functions (main: 1)
+        for block in blocks or []:
+            self.add_block(block['file'], block['line'], block['function'], block['count'], block.get('entry', False))
+
+    @classmethod
+    def from_file(cls, filename):
+        ## raises OSError or ValueError
+        with open(filename, 'r') as f:
+            profile_json = json.load(f)
+        try:
+            return cls(profile_json['blocks'])
+        except (KeyError, TypeError, AttributeError) as e:
+            raise ValueError(f'invalid profile: {e!r}') from None
+
+    def save(self, filename):
+        ## one line per block, raises OSError
+        with open(filename, 'w') as f:
+            f.write('{"blocks": [\n' + ',\n'.join(json.dumps(block) for block in self.blocks) + '\n]}\n')
+
+    def add_block(self, filename, row, func_name, count, is_entry):
+        ## filename: str, C source file (compared by name only, the profile may be used from another directory)
+        filename = PurePath(filename).name
+        self.blocks.append({'file': filename, 'line': int(row), 'function': func_name, 'count': int(count),
+            'entry': bool(is_entry)})
+        key = (filename, int(row))
+        self.line_counts[key] = max(self.line_counts.get(key, 0), int(count))
+        if is_entry:
+            self.func_counts[func_name] = self.func_counts.get(func_name, 0) + int(count)
+
+    def line_count(self, filename, row):
+        ## returns None (row starts no counted block) or int, execution count of the code starting in row
+        return self.line_counts.get((PurePath(filename or '').name, row))
+
+    def func_count(self, func_name):
+        ## returns None (not profiled) or int, number of calls of function func_name
+        return self.func_counts.get(func_name)
+
+## ---------------------------------------------------------------------------
+
+class PccPasses:
+    ## named optimization passes, the optimization level (-O) enables a preset of them, single passes are
+    ## enabled or disabled on top of it (-f PASS, -f no-PASS), the optimization level still selects the
+    ## limits of the enabled passes: "1" balanced, "2" fewest executed instructions in loops, "s" smallest
+    ## script, fewest tags and variables
+    PASSES = {                              ## dict(str pass_name: str description), in pipeline order
+        'evaluate':         'evaluate calls of pure functions with constant arguments',
+        'strength-reduce':  'replace "*", "/" and "%" by constants with cheaper code',
+        'hoist':            'compute loop-invariant expressions in front of loops',
+        'count-loops':      'test the flags of INR/DCR in counting for loops',
+        'merge-writes':     'merge constant gpioWrite() statements into bank writes',
+        'unroll':           'unroll for loops with constant trip count',
+        'inline':           'expand calls of small user-defined functions in-line',
+        'peephole':         'replace instruction sequences by shorter ones',
+        'inline-helpers':   'expand calls of emulated instructions in-line (CIS)',
+        'acc-args':         'pass the first argument of user-defined functions in A',
+        'dce':              'drop unreachable code, dead stores and dead computations',
+    }
+    PRESETS = {                             ## dict(str opt_level: tuple(str pass_name)), enabled passes
+        '0': ('peephole',),
+        '1': tuple(PASSES),
+        '2': tuple(PASSES),
+        's': tuple(pass_name for pass_name in PASSES if pass_name != 'hoist'),
+    }
+
+    def __init__(self, opt_level='1', flags=()):
+        ## flags: iterable(str), "PASS" enables and "no-PASS" disables pass PASS, raises ValueError
+        if opt_level not in self.PRESETS:
+            raise ValueError(f'unknown optimization level "{opt_level}", expected one of {", ".join(self.PRESETS)}')
+        self.opt_level = opt_level          ## str, optimization level "0", "1", "2" or "s"
+        self.enabled = set(self.PRESETS[opt_level]) ## set(str), names of enabled passes
+        self.seconds = dict.fromkeys(self.PASSES, 0.0) ## dict(str pass_name: float), compile time spent per pass
+        self._timers = []                   ## list(list(str pass_name, float t_start)), running timers, innermost last
+        for flag in self.parse_flags(flags):
+            pass_name = flag[3:] if flag.startswith('no-') else flag
+            if flag.startswith('no-'):
+                self.enabled.discard(pass_name)
+            else:
+                self.enabled.add(pass_name)
+
+    @classmethod
+    def parse_flags(cls, flags):
+        ## returns list(str), flags checked for known pass names, raises ValueError
+        try:
+            flags = None if isinstance(flags, str) else list(flags)
+        except TypeError:
+            flags = None
+        if flags is None or not all(isinstance(flag, str) for flag in flags):
+            raise ValueError('optimization pass flags expect a list of pass names')
+        for flag in flags:
+            pass_name = flag[3:] if flag.startswith('no-') else flag
+            if pass_name not in cls.PASSES:
+                raise ValueError(f'unknown optimization pass "{pass_name}", expected one of {", ".join(cls.PASSES)}')
+        return flags
+
+    def __contains__(self, pass_name):
+        return pass_name in self.enabled
+
+    def limit_level(self):
+        ## returns str, optimization level selecting the limits of the enabled passes ("0" behaves as "1")
+        return '1' if self.opt_level == '0' else self.opt_level
+
+    @contextlib.contextmanager
+    def timed(self, pass_name):
+        ## accounts the time spent in the with-block to pass_name, nested timed blocks excluded
+        t_now = time.perf_counter()
+        if len(self._timers) > 0:
+            outer_timer = self._timers[-1]
+            self.seconds[outer_timer[0]] += t_now - outer_timer[1]
+        timer = [pass_name, t_now]
+        self._timers.append(timer)
+        try:
+            yield
+        finally:
+            t_now = time.perf_counter()
+            self.seconds[pass_name] += t_now - timer[1]
+            self._timers.pop()
+            if len(self._timers) > 0:
+                self._timers[-1][1] = t_now
+
+class PccPassReport:
+    ## effect of each enabled optimization pass: the program is compiled once more without the pass,
+    ## instructions, tags and variables saved are the differences to the program compiled with all passes
+    class Entry:
+        def __init__(self, pass_name, is_enabled, seconds, saved=None):
+            self.pass_name = pass_name      ## str, optimization pass name
+            self.is_enabled = is_enabled    ## bool, True: pass enabled
+            self.seconds = seconds          ## float, compile time spent in the pass
+            ## None (disabled or not compilable without the pass) or tuple(int instrs, int tags, int vars), saved
+            self.saved = saved
+
+    def __init__(self, passes):
+        self.passes = passes                ## PccPasses, enabled passes and their compile times
+        self.entries = []                   ## list(Entry), report entries in pipeline order
+        self.total = None                   ## None or tuple(int instrs, int tags, int vars), program with all passes
+        self.seconds = 0.0                  ## float, compile time of the program with all passes
+
+    def analyze(self, cc_result, seconds, compile_without):
+        ## cc_result: PccResult, program compiled in seconds with all passes enabled
+        ## compile_without: callable(str pass_name) returning None or PccResult, compiles without pass_name
+        self.total = self.program_size(cc_result)
+        self.seconds = seconds
+        for pass_name in self.passes.PASSES:
+            saved = None
+            if pass_name in self.passes:
+                cc_result_without = compile_without(pass_name)
+                if cc_result_without is not None:
+                    saved = tuple(count_without - count for count_without, count
+                        in zip(self.program_size(cc_result_without), self.total))
+            self.entries.append(self.Entry(pass_name, pass_name in self.passes, self.passes.seconds[pass_name], saved))
+
+    @staticmethod
+    def program_size(cc_result):
+        ## returns tuple(int instrs, int tags, int vars), static size of compiled program cc_result
+        instr_count = sum(1 for asm_line in cc_result.asm_code.splitlines()
+            if asm_line.split(';')[0].strip() != '' and asm_line.split()[0] != 'TAG')
+        return (instr_count, cc_result.tag_count, cc_result.var_count)
+
+    CODEGEN_STEPS = ('constant folding', 'CMP branches', 'loop rotation', 'operand scheduling', 'F=A elision')
+
+    def format(self):
+        lines = [f'optimization pass report -O{self.passes.opt_level} (saved: compared to compiling without the pass)',
+            f'{"pass":<16} {"instrs":>6} {"tags":>6} {"vars":>6} {"ms":>8}']
+        for entry in self.entries:
+            if not entry.is_enabled:
+                lines.append(f'{entry.pass_name:<16} {"off":>6}')
+                continue
+            saved = entry.saved if entry.saved is not None else ('-',) * 3
+            lines.append(f'{entry.pass_name:<16} {saved[0]:>6} {saved[1]:>6} {saved[2]:>6} {entry.seconds * 1000:>8.1f}')
+        lines.append(f'{"total":<16} {self.total[0]:>6} {self.total[1]:>6} {self.total[2]:>6} {self.seconds * 1000:>8.1f}')
+        lines.append(f'not passes, applied at every level: {", ".join(self.CODEGEN_STEPS)}')
+        return '\n'.join(lines)
+
 ## ---------------------------------------------------------------------------
 
 class CSourceBundle:
-    def read_files(self, filenames):
+    def read_files(self, filenames, placeholder_filenames=(), sources=None, log_file=sys.stderr):
+        ## placeholder_filenames: files whose lines are only represented by empty lines in the
+        ## returned source code (their parsed state comes from elsewhere), line numbering is kept
+        ## sources: None or dict(str filename: str c_source), in-memory files used instead of reading filename
         self.c_source_files = {}    ## dict(str filename: list(str line))
         self.c_segments = []        ## list(tuple(str seg_filename, int flat_idx_start, int flat_idx_end))
         ttl_line_count = 0          ## int, total number of lines
         c_result = ''               ## str, combined and cleaned source code
         try:
             for filename in filenames:
-                with open(filename, 'r') as f:
-                    c_source_lines = list(line.rstrip('\r\n') for line in f.readlines())
+                if sources is not None and filename in sources:
+                    c_source_lines = sources[filename].splitlines()
+                else:
+                    with open(filename, 'r') as f:
+                        c_source_lines = list(line.rstrip('\r\n') for line in f.readlines())
                 self.c_source_files[filename] = c_source_lines
                 self.c_segments.append((filename, ttl_line_count, ttl_line_count + len(c_source_lines)))
                 ttl_line_count += len(c_source_lines)
-                c_result += '\n'.join(c_source_lines) + '\n'
+                if filename in placeholder_filenames:
+                    c_result += '\n' * len(c_source_lines)
+                else:
+                    c_result += '\n'.join(c_source_lines) + '\n'
         except OSError as e:
-            print(str(e), file=sys.stderr)
+            print(str(e), file=log_file)
             return None
-        c_result = re.sub(r'//.*', '', c_result)
-        c_result = re.sub(r'/\*(.|\n)*?\*/', lambda m: re.sub(r'[^\n]', '', m.group(0)), c_result)
-        return c_result
+        return self.strip_comments(c_result)
+
+    def source_of(self, filename):
+        ## returns str, cleaned source code of a single file read before
+        return self.strip_comments('\n'.join(self.c_source_files[filename]) + '\n')
+
+    @staticmethod
+    def strip_comments(c_source):
+        c_source = re.sub(r'//.*', '', c_source)
+        return re.sub(r'/\*(.|\n)*?\*/', lambda m: re.sub(r'[^\n]', '', m.group(0)), c_source)
 
     def map_coord(self, flat_row):
         ## map flat_row to (filename, row)
@@ -1212,37 +4292,184 @@ class CSourceBundle:
     def line_at(self, filename, row):
         return self.c_source_files[filename][row-1]
 
+class VmApiHeader:
+    FORMAT_VERSION = 1                      ## int, cache file format, increment when VmApiHeader changes
+    _pcc_digest = None                      ## None or bytes, content hash of pcc.py once computed
+    _pickled = {}                           ## dict(Path cache_path: bytes), cache files loaded by this process
+
+    def __init__(self, symbols, functions):
+        self.symbols = symbols              ## dict(str cname: AbstractSymbol), global symbols declared in vm_api.h
+        self.functions = functions          ## dict(str func_name: Function), functions declared in vm_api.h
+
+    def folder_names(self):
+        ## returns dict(str cname: int or AstConstantFolder.OPAQUE), names for AstConstantFolder's global scope
+        names = {}
+        for cname, symbol in self.symbols.items():
+            if isinstance(symbol, EnumSymbol):
+                names[cname] = AstConstantFolder.int32(AstConstantFolder.parse_int(symbol.const_value))
+            else:
+                names[cname] = AstConstantFolder.OPAQUE
+        return names
+
+    @classmethod
+    def load(cls, filename, c_sources, log, use_cis, cache_dir=None):
+        ## returns None or VmApiHeader, compiler state after declaring the symbols of header file
+        ## filename (read before into c_sources), cached on disk keyed by the content hash of the header,
+        ## of pcc.py and the instruction set, cache_dir defaults to $PCC_CACHE_DIR or ~/.cache/pcc
+        c_source = c_sources.source_of(filename)
+        key = hashlib.sha256()
+        key.update(f'{cls.FORMAT_VERSION} {use_cis} {sys.version_info[:2]}\n'.encode())
+        key.update(c_source.encode())
+        if cls._pcc_digest is None:
+            with open(__file__, 'rb') as f:
+                cls._pcc_digest = hashlib.sha256(f.read()).digest()
+        key.update(cls._pcc_digest)
+        if cache_dir is None:
+            cache_dir = os.environ.get('PCC_CACHE_DIR', Path.home() / '.cache' / 'pcc')
+        cache_path = Path(cache_dir) / f'{PurePath(filename).stem}-{key.hexdigest()[:32]}.pickle'
+        try:
+            ## each compile gets its own unpickled copy, the compiler modifies the declared functions
+            pickled = cls._pickled.get(cache_path)
+            if pickled is None:
+                with open(cache_path, 'rb') as f:
+                    pickled = f.read()
+            header = pickle.loads(pickled)
+            if isinstance(header, cls):
+                cls._pickled[cache_path] = pickled
+                return header
+        except Exception:                   ## missing, unreadable or stale cache file
+            pass
+        header = cls.parse(filename, c_sources, log, use_cis)
+        if header is not None:
+            pickled = pickle.dumps(header, protocol=pickle.HIGHEST_PROTOCOL)
+            cls._pickled[cache_path] = pickled
+            try:
+                cache_path.parent.mkdir(parents=True, exist_ok=True)
+                tmp_path = cache_path.with_suffix(f'.{os.getpid()}.tmp')
+                with open(tmp_path, 'wb') as f:
+                    f.write(pickled)
+                os.replace(tmp_path, cache_path)
+            except OSError:
+                pass
+        return header
+
+    @classmethod
+    def parse(cls, filename, c_sources, log, use_cis):
+        ## returns None or VmApiHeader, parses and declares header file filename (read before into
+        ## c_sources), the header must be the first file in c_sources to match its line numbers
+        try:
+            ast = CParser().parse(c_sources.source_of(filename), filename)
+        except ParseError as e:
+            print(e, file=log.file)
+            return None
+        astcc = AstCompiler(log, c_sources, use_cis=use_cis)
+        if astcc.compile(ast) != 0:
+            return None
+        return cls(dict(astcc.scope.maps[0]), astcc.functions)
+
 class PccResult:
-    def __init__(self, var_count, tag_count, asm_code):
+    def __init__(self, var_count, tag_count, asm_code, cost_report=None, profile_counters=None):
         self.var_count = var_count
         self.tag_count = tag_count
         self.asm_code = asm_code
-
-def pcc(filenames, use_cis=True, do_reduce=True, use_comments=False, debug=False):
-    ## build C translation unit from input files
+        self.cost_report = cost_report      ## None or VmCostReport, static cost report
+        ## None or list(tuple(str filename, int row, str func_name, bool is_entry)), C source position of
+        ## each profile counter in dump order (see AsmProfiler)
+        self.profile_counters = profile_counters
+        self.pass_report = None             ## None or PccPassReport, effect and compile time of optimization passes
+
+def pcc(filenames, use_cis=True, do_reduce=True, use_comments=False, debug=False, opt_level='1', cost_model=None,
+        use_header_cache=True, cache_dir=None, sources=None, log_file=sys.stderr, c_parser=None, halt_event=None,
+        profile=False, use_profile=None, passes=(), pass_report=False):
+    ## build C translation unit from input files, the implicitly included vm_api.h is
+    ## taken from the header cache and only represented by its line count
+    ## sources: None or dict(str filename: str c_source), in-memory input files
+    ## log_file: file-like object, sink of diagnostics (errors, warnings and debug output)
+    ## c_parser: None or CParser, parser instance to reuse
+    ## halt_event: None or int 0 ... 31, VM event triggered right before the script halts
+    ## profile: bool, True: count basic block executions, see AsmProfiler and PccResult.profile_counters
+    ## use_profile: None, str filename or PccProfile, execution counts guiding branch layout, in-line
+    ## expansion and unrolling
+    ## passes: iterable(str), "PASS" or "no-PASS" flags enabling or disabling optimization passes of
+    ## opt_level (see PccPasses), do_reduce False disables "peephole" and "dce"
+    ## pass_report: bool, True: compile once more per enabled pass to report its effect (PccResult.pass_report)
+    t_start = time.perf_counter()
+    if halt_event is not None and not 0 <= halt_event <= 31:
+        print(f'error: invalid HALT event {halt_event}, expected 0 ... 31', file=log_file)
+        return None
+    try:
+        pass_flags = PccPasses.parse_flags(passes) + ([] if do_reduce else ['no-peephole', 'no-dce'])
+        pass_set = PccPasses(opt_level, pass_flags)
+    except ValueError as e:
+        print(f'error: {e}', file=log_file)
+        return None
+    if isinstance(use_profile, str):
+        try:
+            use_profile = PccProfile.from_file(use_profile)
+        except (OSError, ValueError) as e:
+            print(f'error: profile "{use_profile}": {e}', file=log_file)
+            return None
+    input_filenames = filenames
+    header_filename = None
     if 'vm_api.h' not in [PurePath(filename).name for filename in filenames]:
-        filenames = [str(Path(__file__).resolve().with_name('vm_api.h'))] + filenames
+        header_filename = str(Path(__file__).resolve().with_name('vm_api.h'))
+        filenames = [header_filename] + filenames
     c_sources = CSourceBundle()
-    c_translation_unit = c_sources.read_files(filenames)
+    c_translation_unit = c_sources.read_files(filenames,
+        [header_filename] if header_filename is not None and use_header_cache else (), sources, log_file)
     if c_translation_unit is None:
         return None
 
+    ## load compiler state of implicitly included vm_api.h
+    log = PccLogger(c_sources, debug, log_file)
+    header = None
+    if header_filename is not None and use_header_cache:
+        header = VmApiHeader.load(header_filename, c_sources, log, use_cis, cache_dir)
+        if header is None:
+            return None
+
     ## build abstract syntax tree (AST) from C translation unit
-    log = PccLogger(c_sources, debug)
     try:
-        ast = CParser().parse(c_translation_unit)
+        ast = (c_parser if c_parser is not None else CParser()).parse(c_translation_unit)
     except ParseError as e:
         m = re.fullmatch(r'[^:]*?:(\d+):(\d+):\s*(.*)', str(e))
         if m is None:
-            print(e, file=sys.stderr)
+            print(e, file=log_file)
         else:
             flat_row, col, message = int(m[1]), int(m[2]), m[3]
             log.error_msg(flat_row, col, message)
-        print('*** aborted with parser error', file=sys.stderr)
+        print('*** aborted with parser error', file=log_file)
         return None
 
+    ## fold constant expressions and propagate constant variables
+    folder_names = header.folder_names() if header is not None else None
+    folder = AstConstantFolder(folder_names)
+    folder.fold(ast)
+
+    ## evaluate calls of pure user-defined functions with constant arguments, fold their values
+    evaluator = None
+    if 'evaluate' in pass_set:
+        with pass_set.timed('evaluate'):
+            evaluator = AstFunctionEvaluator(folder.scope.maps[0])
+            evaluator.declare(ast)
+            while evaluator.evaluate_calls(ast) > 0:
+                AstConstantFolder(folder_names).fold(ast)
+    output_gpios = None
+    if 'merge-writes' in pass_set:
+        with pass_set.timed('merge-writes'):
+            output_gpios = VmApiFunction.find_output_gpios(ast, folder)
+
     ## transform AST into intermediate representation
-    astcc = AstCompiler(log, c_sources, use_cis=use_cis)
+    limit_level = pass_set.limit_level()
+    unroll_growth = None
+    if 'unroll' in pass_set:
+        unroll_growth = (UNROLL_MAX_STMT_GROWTH, UNROLL_MAX_TAG_GROWTH) if limit_level == '2' else (0, 0)
+    astcc = AstCompiler(log, c_sources, use_cis=use_cis, cost_model=cost_model,
+        strength_reduce='strength-reduce' in pass_set, hoist_invariants='hoist' in pass_set,
+        count_loops='count-loops' in pass_set, output_gpios=output_gpios, unroll_growth=unroll_growth,
+        call_evaluator=evaluator, profile=use_profile, optimize_size=limit_level == 's', passes=pass_set)
+    if header is not None:
+        astcc.declare_header(header)
     if astcc.compile(ast) != 0:
         return None
 
@@ -1257,6 +4484,17 @@ def pcc(filenames, use_cis=True, do_reduce=True, use_comments=False, debug=False
             else:
                 userdef_functions.append(function)
 
+    ## expand calls of small user-defined functions in-line
+    inliner = FunctionInliner(limit_level, use_profile)
+    if 'inline' in pass_set:
+        with pass_set.timed('inline'):
+            inliner.inline([f for f in [main_function] + userdef_functions if f is not None and f.impl_node is not None],
+                astcc.em_instrs if use_cis else None)
+    if debug and inliner.inline_count > 0:
+        print(f'in-line expanded function calls: {inliner.inline_count}', file=log_file)
+    if debug and evaluator is not None and evaluator.eval_count > 0:
+        print(f'compile-time evaluated function calls: {evaluator.eval_count}', file=log_file)
+
     ## incrementally drop non-called functions
     while len(userdef_functions) > 0:
         functions_passed = []
@@ -1290,15 +4528,57 @@ def pcc(filenames, use_cis=True, do_reduce=True, use_comments=False, debug=False
     for function in userdef_functions:
         tags[function.asm_tag] = 1
     userdef_asm_bufs = [main_function.asm_buf] + [f.asm_buf for f in userdef_functions]
+    peephole = AsmPeepholeOptimizer(set(tags))
     for asm_buf in userdef_asm_bufs:
         asm_buf.drop_unused_tags(tags.copy())
-        if do_reduce:
-            asm_buf.reduce()
+        if 'peephole' in pass_set:
+            with pass_set.timed('peephole'):
+                asm_buf.reduce(peephole)
+
+    ## expand calls of emulated instructions in-line where worthwhile
+    if use_cis and 'inline-helpers' in pass_set:
+        counted_bufs = [init_asm_buf] + userdef_asm_bufs + astcc.em_instrs.asm_bufs()
+        tag_count = sum(1 for asm_buf in counted_bufs for asm_stmt in asm_buf.stmt_buf if isinstance(asm_stmt, AsmTag))
+        stmt_count = sum(len(asm_buf.stmt_buf) for asm_buf in counted_bufs) - tag_count
+        with pass_set.timed('inline-helpers'):
+            inlined_bufs = astcc.em_instrs.inline_calls([init_asm_buf] + userdef_asm_bufs, limit_level, tag_count,
+                stmt_count)
+        for asm_buf in inlined_bufs:
+            if 'peephole' in pass_set:
+                with pass_set.timed('peephole'):
+                    asm_buf.reduce(peephole)
+
+    ## pass first arguments in A where the callee starts by loading them
+    if 'acc-args' in pass_set:
+        acc_args = AccumulatorArgPasser()
+        with pass_set.timed('acc-args'):
+            acc_arg_bufs = acc_args.apply(userdef_functions, [init_asm_buf] + userdef_asm_bufs)
+        for asm_buf in acc_arg_bufs:
+            if 'peephole' in pass_set:
+                with pass_set.timed('peephole'):
+                    asm_buf.reduce(peephole)
+        if debug and acc_args.function_count > 0:
+            print(f'functions taking their first argument in A: {acc_args.function_count}', file=log_file)
+
+    ## drop unreachable code and dead stores to local variables
+    if 'dce' in pass_set:
+        call_reads = {function.asm_tag: list(function.passed_arg_vars) for function in userdef_functions}
+        dead_code = AsmDeadCodeEliminator(set(tags), call_reads)
+        with pass_set.timed('dce'):
+            dead_code.eliminate([(main_function, main_function.asm_buf)] + [(f, f.asm_buf) for f in userdef_functions],
+                peephole if 'peephole' in pass_set else None)
+        if debug:
+            for name, hit_count in dead_code.hit_counts.items():
+                print(f'dead code elimination "{name}": {hit_count} hit(s)', file=log_file)
+    if debug and 'peephole' in pass_set:
+        for rule_name, hit_count in peephole.hit_counts.items():
+            print(f'peephole rule "{rule_name}": {hit_count} hit(s)', file=log_file)
 
     ## merge main() function body into init segment
     main_function.asm_buf.replace_instruction('RET', 'HALT')
     init_asm_buf.stmt_buf.extend(main_function.asm_buf.stmt_buf)
     all_asm_bufs = [init_asm_buf] + userdef_asm_bufs[1:]
+
     if use_cis:
         all_asm_bufs += astcc.em_instrs.asm_bufs()
 
@@ -1312,11 +4592,26 @@ def pcc(filenames, use_cis=True, do_reduce=True, use_comments=False, debug=False
         tag_count += n_tags
         tag_base = ((tag_base + n_tags + 10) // 10) * 10
         asm_buf.collect_vm_variables(global_asm_vars, local_asm_vars)
-    all_asm_vars = list(global_asm_vars.keys()) + list(local_asm_vars.keys())
-    var_count = 1 + len(ARG_REGS)   ## int, total number of variables
-    for asm_var in all_asm_vars:
-        asm_var.bind(var_count)
-        var_count += 1
+    func_asm_bufs = [(main_function, init_asm_buf)] + [(f, f.asm_buf) for f in userdef_functions]
+    var_alloc = VmVariableAllocator(1 + len(ARG_REGS))
+    var_count = var_alloc.allocate(func_asm_bufs, global_asm_vars, local_asm_vars)
+    all_asm_vars = sorted(list(global_asm_vars.keys()) + list(local_asm_vars.keys()),
+        key=lambda asm_var: int(asm_var.vm_var_id[1:]))
+
+    ## count basic block executions in spare VM variables, dump the counters before HALT
+    profiler = None
+    if profile:
+        profiler = AsmProfiler(c_sources, log)
+        profile_asm_buf = profiler.instrument(func_asm_bufs, var_count)
+        if profile_asm_buf is not None:
+            tag_count += profile_asm_buf.bind_tags(tag_base)
+            var_count += len(profiler.counters) + 10
+            all_asm_bufs.append(profile_asm_buf)
+
+    ## signal script completion to the host, see pipcc.py
+    if halt_event is not None:
+        for asm_buf in all_asm_bufs:
+            asm_buf.insert_before('HALT', 'EVT', halt_event, comment='signal HALT')
 
     ## transform intermediate representation into assembly code
     asm_code = []
@@ -1337,6 +4632,9 @@ def pcc(filenames, use_cis=True, do_reduce=True, use_comments=False, debug=False
             asm_code.append(f'; {asm_var!s: >3}: '
                    f'{PurePath(filename).name}:{row}:{coord.column}: '
                    f'{var_sym.ctype} {fqname}')
+        if profiler is not None:
+            for counter_var, func_name, filename, row, is_entry in profiler.counters:
+                asm_code.append(f'; {counter_var!s: >3}: {PurePath(filename or "").name}:{row}: profile counter')
     for asm_buf in all_asm_bufs:
         if len(asm_code) > 0:
             asm_code.append('')
@@ -1346,22 +4644,178 @@ def pcc(filenames, use_cis=True, do_reduce=True, use_comments=False, debug=False
                 asm_line = f'{asm_line: <24}; {asm_stmt.comment}'
             asm_code.append(asm_line)
 
-    return PccResult(var_count, tag_count, '\n'.join(asm_code))
+    ## estimate static cost of functions, loops and emulated instructions
+    cost_report = None
+    if cost_model is not None:
+        code_bufs = [('function', 'main', init_asm_buf, None)]
+        code_bufs += [('function', f.func_name, f.asm_buf, f.asm_tag) for f in userdef_functions]
+        if use_cis:
+            code_bufs += [('helper', instr, instr_func.asm_buf, instr_func.asm_tag)
+                for instr, instr_func in astcc.em_instrs.instr_funcs.items()]
+        cost_report = VmCostReport(cost_model)
+        cost_report.analyze(code_bufs, astcc.loop_names)
+
+    profile_counters = None
+    if profiler is not None:
+        profile_counters = [(filename, row, func_name, is_entry)
+            for counter_var, func_name, filename, row, is_entry in profiler.counters]
+    cc_result = PccResult(var_count, tag_count, '\n'.join(asm_code), cost_report, profile_counters)
+
+    ## compile once more without each enabled pass to measure its effect
+    if pass_report:
+        seconds = time.perf_counter() - t_start
+        c_parser = c_parser if c_parser is not None else CParser()
+        cc_result.pass_report = PccPassReport(pass_set)
+        cc_result.pass_report.analyze(cc_result, seconds,
+            lambda pass_name: pcc(input_filenames, use_cis=use_cis, opt_level=opt_level,
+                use_header_cache=use_header_cache, cache_dir=cache_dir, sources=sources, log_file=io.StringIO(),
+                c_parser=c_parser, halt_event=halt_event, profile=profile, use_profile=use_profile,
+                passes=pass_flags + [f'no-{pass_name}']))
+    return cc_result
+
+## ---------------------------------------------------------------------------
+
+class PccBatchCompiler:
+    JOB_OPTIONS = {                         ## dict(str option: any default), pcc() options a job may override
+        'use_cis': True, 'do_reduce': True, 'use_comments': False, 'debug': False, 'opt_level': '1',
+        'use_header_cache': True, 'cost_report': False, 'halt_event': None, 'use_profile': None, 'passes': [],
+        'pass_report': False }
+
+    def __init__(self, processes=1, **options):
+        self.processes = processes          ## int, number of worker processes (1: compile in this process)
+        self.options = dict(self.JOB_OPTIONS, **options)    ## dict(str option: any), default job options
+        self.c_parser = None                ## None or CParser, parser reused by all jobs of this process
+        self.pool = None                    ## None or multiprocessing.Pool, worker processes
+
+    def compile_job(self, job):
+        ## returns dict, compiles a single job in this process
+        ## job: dict with optional keys "id" (any, returned as-is), "files" (list(str filename), input files in
+        ## translation order), "sources" (dict(str filename: str c_source), in-memory input files, compiled in
+        ## given order unless listed in "files") and any of JOB_OPTIONS to override the default options
+        result = {'id': None, 'ok': False, 'asm_code': None, 'var_count': None, 'tag_count': None,
+            'diagnostics': '', 'cost_report': None, 'pass_report': None}
+        log_file = io.StringIO()
+        if not isinstance(job, dict):
+            print(f'error: invalid job {job!r}', file=log_file)
+            result['diagnostics'] = log_file.getvalue()
+            return result
+        try:
+            result['id'] = job.get('id')
+            options = dict(self.options)
+            for option in self.JOB_OPTIONS:
+                if option in job:
+                    options[option] = job[option]
+            sources = job.get('sources', {})
+            filenames = list(job.get('files', sources.keys()))
+            if len(filenames) == 0:
+                raise PccError(None, 'job without input files')
+            if self.c_parser is None:
+                self.c_parser = CParser()
+            cc_result = pcc(filenames, use_cis=options['use_cis'], do_reduce=options['do_reduce'],
+                use_comments=options['use_comments'], debug=options['debug'], opt_level=str(options['opt_level']),
+                cost_model=VmCostModel() if options['cost_report'] else None,
+                use_header_cache=options['use_header_cache'], sources=sources, log_file=log_file,
+                c_parser=self.c_parser, halt_event=options['halt_event'], use_profile=options['use_profile'],
+                passes=options['passes'], pass_report=options['pass_report'])
+            if cc_result is not None:
+                result.update(ok=True, asm_code=cc_result.asm_code, var_count=cc_result.var_count,
+                    tag_count=cc_result.tag_count)
+                if cc_result.cost_report is not None:
+                    result['cost_report'] = cc_result.cost_report.format()
+                if cc_result.pass_report is not None:
+                    result['pass_report'] = cc_result.pass_report.format()
+        except PccError as e:
+            print(f'error: {e}', file=log_file)
+        except Exception:
+            print(f'*** internal compiler error:\n{traceback.format_exc()}', file=log_file)
+            self.c_parser = None            ## parser state after an exception is unknown
+        result['diagnostics'] = log_file.getvalue()
+        return result
+
+    def compile_jobs(self, jobs):
+        ## returns iterator(dict), results of iterable jobs in the same order, see compile_job()
+        if self.processes <= 1:
+            return map(self.compile_job, jobs)
+        if self.pool is None:
+            self.pool = multiprocessing.Pool(self.processes, _init_batch_worker, (self.options,))
+        return self.pool.imap(_compile_batch_job, jobs)
+
+    def close(self):
+        if self.pool is not None:
+            self.pool.close()
+            self.pool.join()
+            self.pool = None
+
+_batch_worker = None                        ## None or PccBatchCompiler, compiler of a worker process
+
+def _init_batch_worker(options):
+    global _batch_worker
+    _batch_worker = PccBatchCompiler(**options)
+
+def _compile_batch_job(job):
+    return _batch_worker.compile_job(job)
+
+def pcc_batch(jobs, processes=None, **options):
+    ## returns list(dict), compiles iterable jobs in parallel in processes worker processes
+    ## (default: number of CPUs), see PccBatchCompiler.compile_job() for jobs and results
+    batch = PccBatchCompiler(os.cpu_count() if processes is None else processes, **options)
+    try:
+        return list(batch.compile_jobs(jobs))
+    finally:
+        batch.close()
 
 ## ---------------------------------------------------------------------------
 
 def main():
     parser = argparse.ArgumentParser(description='pcc - PIGS C compiler')
-    parser.add_argument('filenames', metavar='C_FILE', nargs='+', help='filenames to parse')
+    parser.add_argument('filenames', metavar='C_FILE', nargs='*', help='filenames to parse')
     parser.add_argument('-e', dest='use_cis', action='store_false', help='use extended instruction set')
     parser.add_argument('-n', dest='do_reduce', action='store_false', help='do not reduce asm output')
+    parser.add_argument('-O', dest='opt_level', choices=('0', '1', '2', 's'), default='1',
+        help='optimization level, 2: fewest executed instructions, s: smallest script (default: 1)')
+    parser.add_argument('-f', dest='passes', metavar='[no-]PASS', action='append', default=[],
+        help=f'enable or disable optimization pass PASS (repeatable), one of {", ".join(PccPasses.PASSES)}')
+    parser.add_argument('--pass-report', dest='pass_report', action='store_true',
+        help='print instructions, tags and variables saved and compile time per optimization pass to STDERR')
     parser.add_argument('-o', dest='out_filename', metavar='FILE', help='place the output into FILE ("-" for STDOUT)')
     parser.add_argument('-c', dest='use_comments', action='store_true', help='add comments to asm output')
-    parser.add_argument('-d', dest='debug', action='store_true', help='add debug output to error messages')
+    parser.add_argument('-r', dest='cost_report', action='store_true', help='print static cost report to STDERR')
+    parser.add_argument('--cost-table', dest='cost_table', metavar='FILE', help='read cost report instruction weights from INI FILE')
+    parser.add_argument('--no-header-cache', dest='use_header_cache', action='store_false',
+        help='always parse the implicitly included vm_api.h')
+    parser.add_argument('--halt-event', dest='halt_event', metavar='EVENT', type=int,
+        help='trigger VM event EVENT (0 ... 31) before the script halts')
+    parser.add_argument('-p', '--profile', dest='profile', action='store_true',
+        help='count basic block executions, collected by pipcc.py --profile')
+    parser.add_argument('--use-profile', dest='use_profile', metavar='FILE',
+        help='lay out branches, expand functions in-line and unroll loops guided by the profile FILE')
+    parser.add_argument('--batch', dest='batch', action='store_true',
+        help='read compile jobs from STDIN and write results to STDOUT, one JSON object per line')
+    parser.add_argument('-j', dest='processes', metavar='N', type=int, default=1,
+        help='number of worker processes in batch mode (default: 1)')
+    parser.add_argument('-d', dest='debug', action='store_true', help='add debug output to error messages and optimizer statistics')
     args = parser.parse_args()
+    if args.batch:
+        return batch_main(args)
+    if len(args.filenames) == 0:
+        parser.error('the following arguments are required: C_FILE')
+    try:
+        PccPasses(args.opt_level, args.passes)
+    except ValueError as e:
+        parser.error(str(e))
+
+    cost_model = None
+    if args.cost_report or args.cost_table is not None:
+        try:
+            cost_model = VmCostModel() if args.cost_table is None else VmCostModel.from_file(args.cost_table)
+        except (OSError, ValueError, configparser.Error) as e:
+            print(f'error: cost table "{args.cost_table}": {e}', file=sys.stderr)
+            return -1
 
     cc_result = pcc(args.filenames, use_cis=args.use_cis, do_reduce=args.do_reduce,
-        use_comments=args.use_comments, debug=args.debug)
+        use_comments=args.use_comments, debug=args.debug, opt_level=args.opt_level, cost_model=cost_model,
+        use_header_cache=args.use_header_cache, halt_event=args.halt_event, profile=args.profile,
+        use_profile=args.use_profile, passes=args.passes, pass_report=args.pass_report)
     if cc_result is None:
         return -1
 
@@ -1373,8 +4827,36 @@ def main():
     else:
         with open(out_filename, 'w') as f:
             print(cc_result.asm_code, file=f)
-    print(f'\nVM variables used: {cc_result.var_count}/150, tags: {cc_result.tag_count}/50.', file=sys.stderr)
+    print(f'\nVM variables used: {cc_result.var_count}/{VM_MAX_VARS}, tags: {cc_result.tag_count}/{VM_MAX_TAGS}.', file=sys.stderr)
+    if cc_result.cost_report is not None:
+        print(cc_result.cost_report.format(), file=sys.stderr)
+    if cc_result.pass_report is not None:
+        print(cc_result.pass_report.format(), file=sys.stderr)
     return 0
 
+def batch_main(args):
+    ## command line options are the default options of all jobs, results are written in job order
+    ## and flushed per job, a client may thus keep the process running and send jobs as needed
+    def read_jobs():
+        for line in sys.stdin:
+            if line.strip() == '':
+                continue
+            try:
+                yield json.loads(line)
+            except ValueError:
+                yield line.strip()          ## reported by compile_job() as invalid job
+    batch = PccBatchCompiler(args.processes, use_cis=args.use_cis, do_reduce=args.do_reduce,
+        use_comments=args.use_comments, debug=args.debug, opt_level=args.opt_level,
+        use_header_cache=args.use_header_cache, cost_report=args.cost_report, halt_event=args.halt_event,
+        use_profile=args.use_profile, passes=args.passes, pass_report=args.pass_report)
+    failed_count = 0
+    try:
+        for result in batch.compile_jobs(read_jobs()):
+            failed_count += 0 if result['ok'] else 1
+            print(json.dumps(result), flush=True)
+    finally:
+        batch.close()
+    return 0 if failed_count == 0 else -1
+
 if __name__ == "__main__":
     sys.exit(main())
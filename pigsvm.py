@@ -0,0 +1,701 @@
+#!/usr/bin/env python3
+##
+## pigsvm.py
+## Host-side emulator of the pigpiod script VM, runs PIGS scripts without a Raspberry Pi.
+##
+## The module can stand in for the pigpio module in pipcc.py (see pipcc.py --emulate):
+## class pi, exception error and the PI_SCRIPT_* status constants mimic pigpio's interface.
+##
+
+import sys, re, argparse, threading, collections
+from pathlib import PurePath
+
+VM_MAX_VARS = 150                           ## Number of VM variables
+VM_MAX_TAGS = 50                            ## Number of VM tags
+VM_MAX_PARAMS = 10                          ## Number of VM parameters
+VM_STACK_SIZE = 256                         ## Depth of the VM stack shared by CALL/RET and PUSH/POP
+VM_MAX_SCRIPTS = 32                         ## Number of scripts pigpiod can store
+
+## pigpio script status values
+PI_SCRIPT_INITING = 0
+PI_SCRIPT_HALTED  = 1
+PI_SCRIPT_RUNNING = 2
+PI_SCRIPT_WAITING = 3
+PI_SCRIPT_FAILED  = 4
+
+class PigsError(Exception):
+    pass
+
+error = PigsError                           ## pigpio.error counterpart
+
+def int32(value):
+    ## returns int, value truncated to 32 bit signed integer (VM semantics)
+    value &= 0xffffffff
+    return value - 0x100000000 if value & 0x80000000 else value
+
+## ---------------------------------------------------------------------------
+
+class PigsHal:
+    ## stub hardware of the emulated VM: VM API instructions are dispatched to methods
+    ## _instr_<INSTR>(*args) with int arguments (str for the mode and pull letters of MODES and PUD),
+    ## instructions without such a method return 0, subclass to model devices
+    GPIO_COUNT = 54                         ## Number of GPIOs (bank 1 and 2)
+    PI_BAD_GPIO = -3                        ## pigpio error code of an invalid GPIO
+
+    def __init__(self):
+        self.levels = [0] * self.GPIO_COUNT ## list(int), GPIO levels
+        self.modes = [0] * self.GPIO_COUNT  ## list(int), GPIO modes (0: input, 1: output, 2 ... 7: ALT5 ... ALT3)
+        self.pulls = [0] * self.GPIO_COUNT  ## list(int), GPIO pull-up/down (0: off, 1: down, 2: up)
+        self.tick_us = 0                    ## int, emulated microsecond clock, advanced by delays
+        self.event_handlers = []            ## list(callable(int event)), called on EVT
+
+    def execute(self, instr, args):
+        ## returns int, result of VM API instruction instr (becomes A and F)
+        handler = getattr(self, f'_instr_{instr}', None)
+        return 0 if handler is None else int32(handler(*args))
+
+    def advance(self, micros):
+        self.tick_us += max(micros, 0)
+
+    ## Basic and intermediate commands
+
+    def _instr_MODES(self, gpio, mode):
+        return self._instr_MI(gpio, 'RW540123'.find(str(mode).upper()))
+
+    def _instr_MI(self, gpio, mode):
+        if not 0 <= gpio < self.GPIO_COUNT or not 0 <= mode <= 7:
+            return self.PI_BAD_GPIO
+        self.modes[gpio] = mode
+        return 0
+
+    def _instr_MODEG(self, gpio):
+        return self.modes[gpio] if 0 <= gpio < self.GPIO_COUNT else self.PI_BAD_GPIO
+
+    def _instr_PUD(self, gpio, pud):
+        return self._instr_PUDI(gpio, 'ODU'.find(str(pud).upper()))
+
+    def _instr_PUDI(self, gpio, pud):
+        if not 0 <= gpio < self.GPIO_COUNT or not 0 <= pud <= 2:
+            return self.PI_BAD_GPIO
+        self.pulls[gpio] = pud
+        if self.modes[gpio] == 0 and pud != 0:
+            self.levels[gpio] = pud - 1     ## unconnected input follows its pull
+        return 0
+
+    def _instr_READ(self, gpio):
+        return self.levels[gpio] if 0 <= gpio < self.GPIO_COUNT else self.PI_BAD_GPIO
+
+    def _instr_WRITE(self, gpio, level):
+        if not 0 <= gpio < self.GPIO_COUNT:
+            return self.PI_BAD_GPIO
+        self.modes[gpio] = 1
+        self.levels[gpio] = 1 if level else 0
+        return 0
+
+    def _instr_TRIG(self, gpio, pulse_len, level):
+        self.advance(pulse_len)
+        return 0
+
+    def _instr_BR1(self):
+        return self._read_bank(0)
+
+    def _instr_BR2(self):
+        return self._read_bank(32)
+
+    def _instr_BS1(self, bits):
+        return self._write_bank(0, bits, 1)
+
+    def _instr_BS2(self, bits):
+        return self._write_bank(32, bits, 1)
+
+    def _instr_BC1(self, bits):
+        return self._write_bank(0, bits, 0)
+
+    def _instr_BC2(self, bits):
+        return self._write_bank(32, bits, 0)
+
+    ## Event commands
+
+    def _instr_EVT(self, event):
+        for event_handler in self.event_handlers:
+            event_handler(event)
+        return 0
+
+    ## Utility and script-exclusive commands
+
+    def _instr_HWVER(self):
+        return 0xa02082                     ## Raspberry Pi 3 Model B
+
+    def _instr_PIGPV(self):
+        return 79
+
+    def _instr_TICK(self):
+        return self.tick_us
+
+    def _instr_MICS(self, micros):
+        self.advance(micros)
+        return 0
+
+    def _instr_MILS(self, millis):
+        self.advance(millis * 1000)
+        return 0
+
+    ## WAIT and EVTWT return at once as if timed out, no GPIO changes or events occur on their own
+
+    ## Private functions
+
+    def _read_bank(self, gpio_base):
+        bits = 0
+        for gpio in range(gpio_base, min(gpio_base + 32, self.GPIO_COUNT)):
+            bits |= self.levels[gpio] << (gpio - gpio_base)
+        return bits
+
+    def _write_bank(self, gpio_base, bits, level):
+        for gpio in range(gpio_base, min(gpio_base + 32, self.GPIO_COUNT)):
+            if bits & (1 << (gpio - gpio_base)):
+                self.levels[gpio] = level
+        return 0
+
+## ---------------------------------------------------------------------------
+
+class PigsProgram:
+    INSTR_ARG_COUNT = {                     ## dict(str instr: int arg_count), VM instruction set
+        ## core instructions
+        'ADD': 1, 'AND': 1, 'CALL': 1, 'CMP': 1, 'DCR': 1, 'DCRA': 0, 'DIV': 1, 'EVTWT': 1, 'HALT': 0,
+        'INR': 1, 'INRA': 0, 'JM': 1, 'JMP': 1, 'JNZ': 1, 'JP': 1, 'JZ': 1, 'LD': 2, 'LDA': 1, 'MLT': 1,
+        'MOD': 1, 'NOP': 0, 'OR': 1, 'POP': 1, 'POPA': 0, 'PUSH': 1, 'PUSHA': 0, 'RET': 0, 'RLA': 1,
+        'RRA': 1, 'STA': 1, 'SUB': 1, 'TAG': 1, 'WAIT': 1, 'X': 2, 'XA': 1, 'XOR': 1,
+        ## VM API instructions
+        'MODES': 2, 'MODEG': 1, 'PUD': 2, 'READ': 1, 'WRITE': 2, 'PWM': 2, 'PFS': 2, 'PRS': 2, 'GDC': 1,
+        'PFG': 1, 'PRG': 1, 'PRRG': 1, 'SERVO': 2, 'GPW': 1, 'TRIG': 3, 'WDOG': 2, 'BR1': 0, 'BR2': 0,
+        'BC1': 1, 'BC2': 1, 'BS1': 1, 'BS2': 1, 'NO': 0, 'NC': 1, 'NB': 2, 'NP': 1, 'HC': 2, 'HP': 3,
+        'FG': 2, 'FN': 3, 'PADS': 2, 'PADG': 1, 'EVM': 2, 'EVT': 1, 'I2CO': 3, 'I2CC': 1, 'I2CWQ': 2,
+        'I2CRS': 1, 'I2CWS': 2, 'I2CRB': 2, 'I2CWB': 3, 'I2CRW': 2, 'I2CWW': 3, 'I2CPC': 3, 'HWVER': 0,
+        'MICS': 1, 'MILS': 1, 'PIGPV': 0, 'TICK': 0, 'CGI': 0, 'CSI': 1,
+        ## proposed extended instruction set (see README.md, pcc.py -e)
+        'LDAF': 1, 'NOTL': 0, 'ANDL': 1, 'ORL': 1, 'EQ': 1, 'NE': 1, 'GT': 1, 'GE': 1, 'LT': 1, 'LE': 1,
+        'NEG': 0, 'NOT': 0, 'MI': 2, 'PUDI': 2 }
+
+    BRANCH_INSTR = ('CALL', 'JMP', 'JNZ', 'JZ', 'JP', 'JM')
+    VAR_ARG_INSTR = {'DCR': (0,), 'INR': (0,), 'LD': (0,), 'POP': (0,), 'STA': (0,), 'X': (0, 1), 'XA': (0,)}
+    LETTER_ARG_INSTR = {'MODES': 1, 'PUD': 1}   ## instructions with a mode/pull letter argument at given index
+    P_COMMENT = re.compile(r';.*')
+    P_VAR = re.compile(r'([vp])(\d+)')
+
+    def __init__(self, asm_code):
+        ## parse asm_code (comments starting with ";" are ignored), raises PigsError on invalid scripts
+        self.instrs = []                    ## list(tuple(str instr, tuple args)), arg: ("v"|"p", int) or int or str
+        self.tags = {}                      ## dict(str label: int pc), TAG positions
+        self.regions = []                   ## list(str), label of the TAG preceding each instruction ("" if none)
+        tokens = self.P_COMMENT.sub('', asm_code).split()
+        region = ''
+        i_token = 0
+        while i_token < len(tokens):
+            instr = tokens[i_token].upper()
+            if instr not in self.INSTR_ARG_COUNT:
+                raise PigsError(f'unknown instruction "{tokens[i_token]}"')
+            arg_count = self.INSTR_ARG_COUNT[instr]
+            arg_tokens = tokens[i_token+1:i_token+1+arg_count]
+            if len(arg_tokens) != arg_count:
+                raise PigsError(f'{instr}: {arg_count} argument(s) expected')
+            i_token += 1 + arg_count
+            if instr == 'TAG':
+                label = self._parse_label(arg_tokens[0])
+                if label in self.tags:
+                    raise PigsError(f'duplicate TAG {label}')
+                self.tags[label] = len(self.instrs)
+                region = label
+                continue
+            if instr in self.BRANCH_INSTR:
+                args = (self._parse_label(arg_tokens[0]),)
+            else:
+                args = tuple(self._parse_arg(instr, i_arg, arg_token) for i_arg, arg_token in enumerate(arg_tokens))
+            self.instrs.append((instr, args))
+            self.regions.append(region)
+        if len(self.tags) > VM_MAX_TAGS:
+            raise PigsError(f'too many tags ({len(self.tags)}/{VM_MAX_TAGS})')
+        for instr, args in self.instrs:
+            if instr in self.BRANCH_INSTR and args[0] not in self.tags:
+                raise PigsError(f'{instr}: undefined TAG {args[0]}')
+
+    ## Private functions
+
+    @staticmethod
+    def _parse_label(token):
+        if not re.fullmatch(r'\d+', token):
+            raise PigsError(f'invalid TAG label "{token}"')
+        return str(int(token))
+
+    def _parse_arg(self, instr, i_arg, token):
+        m = self.P_VAR.fullmatch(token.lower())
+        if m is not None:
+            kind, index = m[1], int(m[2])
+            if index >= (VM_MAX_VARS if kind == 'v' else VM_MAX_PARAMS):
+                raise PigsError(f'{instr}: invalid variable "{token}"')
+            return (kind, index)
+        if i_arg in self.VAR_ARG_INSTR.get(instr, ()):
+            raise PigsError(f'{instr}: variable expected instead of "{token}"')
+        if self.LETTER_ARG_INSTR.get(instr) == i_arg and re.fullmatch(r'[A-Za-z]', token):
+            return token.upper()
+        try:
+            if re.fullmatch(r'-?0[0-7]+', token):
+                return int32(int(token, 8))
+            return int32(int(token, 0))
+        except ValueError:
+            raise PigsError(f'{instr}: invalid argument "{token}"') from None
+
+## ---------------------------------------------------------------------------
+
+class PigsVm:
+    STOP_CHECK_INTERVAL = 1024              ## number of instructions between checks of the stop request
+
+    def __init__(self, program, hal=None, max_steps=None):
+        self.program = program              ## PigsProgram, script to execute
+        self.hal = hal if hal is not None else PigsHal()    ## PigsHal, emulated hardware
+        self.max_steps = max_steps          ## None or int, limit of executed instructions per run
+        self.v = [0] * VM_MAX_VARS          ## list(int), VM variables v0 ... v149
+        self.p = [0] * VM_MAX_PARAMS        ## list(int), VM parameters p0 ... p9
+        self.a = 0                          ## int, accumulator
+        self.f = 0                          ## int, flags
+        self.stack = []                     ## list(int), shared CALL/RET and PUSH/POP stack
+        self.step_count = 0                 ## int, number of instructions executed by the last run
+        self.pc_counts = [0] * len(program.instrs)  ## list(int), number of times each instruction was executed
+        self.stop_request = threading.Event()       ## set to abort a running run()
+        self._handlers = [getattr(self, f'_exec_{instr}', None) for instr, args in program.instrs]
+
+    def run(self, params=None):
+        ## execute the program from its start until HALT (or its end), params: None or list(int),
+        ## initial values of p0 ... (others keep their values), raises PigsError on runtime errors,
+        ## returns False if stopped by stop_request
+        if params is not None:
+            for i_param, param in enumerate(params[:VM_MAX_PARAMS]):
+                self.p[i_param] = int32(param)
+        self.a = self.f = 0
+        self.stack = []
+        self.step_count = 0
+        self.pc_counts = [0] * len(self.program.instrs)
+        instrs, handlers, pc_counts = self.program.instrs, self._handlers, self.pc_counts
+        pc, n_instrs, max_steps = 0, len(instrs), self.max_steps
+        next_check = self.STOP_CHECK_INTERVAL
+        step_count = 0
+        try:
+            while pc is not None and pc < n_instrs:
+                pc_counts[pc] += 1
+                step_count += 1
+                if step_count >= next_check:
+                    next_check += self.STOP_CHECK_INTERVAL
+                    if self.stop_request.is_set():
+                        return False
+                    if max_steps is not None and step_count > max_steps:
+                        raise PigsError(f'step limit of {max_steps} instructions exceeded')
+                handler = handlers[pc]
+                instr, args = instrs[pc]
+                if handler is None:         ## VM API instruction
+                    self.a = self.f = self.hal.execute(instr, [self._value(arg) for arg in args])
+                    pc += 1
+                else:
+                    pc = handler(pc, *args)
+        except PigsError as e:
+            raise PigsError(f'{e} (instruction {pc}: {self._format_instr(pc)})') from None
+        finally:
+            self.step_count = step_count
+        return True
+
+    def instr_counts(self):
+        ## returns Counter(str instr: int count), executed instructions per instruction name
+        counts = collections.Counter()
+        for (instr, args), count in zip(self.program.instrs, self.pc_counts):
+            if count > 0:
+                counts[instr] += count
+        return counts
+
+    def region_counts(self):
+        ## returns Counter(str label: int count), executed instructions per code region following a TAG
+        counts = collections.Counter()
+        for region, count in zip(self.program.regions, self.pc_counts):
+            if count > 0:
+                counts[region] += count
+        return counts
+
+    def format_statistics(self):
+        lines = [f'executed instructions: {self.step_count}', f'{"instr":<7} {"count":>10}']
+        for instr, count in self.instr_counts().most_common():
+            lines.append(f'{instr:<7} {count:>10}')
+        lines.append(f'{"tag":<7} {"count":>10}')
+        for region, count in self.region_counts().most_common():
+            lines.append(f'{region or "(start)":<7} {count:>10}')
+        return '\n'.join(lines)
+
+    ## Private functions
+
+    def _value(self, arg):
+        if isinstance(arg, tuple):
+            return self.v[arg[1]] if arg[0] == 'v' else self.p[arg[1]]
+        return arg
+
+    def _store(self, arg, value):
+        if arg[0] == 'v':
+            self.v[arg[1]] = int32(value)
+        else:
+            self.p[arg[1]] = int32(value)
+
+    def _format_instr(self, pc):
+        if pc is None or not 0 <= pc < len(self.program.instrs):
+            return '-'
+        instr, args = self.program.instrs[pc]
+        return ' '.join([instr] + [f'{arg[0]}{arg[1]}' if isinstance(arg, tuple) else str(arg) for arg in args])
+
+    def _push(self, value):
+        if len(self.stack) >= VM_STACK_SIZE:
+            raise PigsError('stack overflow')
+        self.stack.append(value)
+
+    def _pop(self):
+        if len(self.stack) == 0:
+            raise PigsError('stack underflow')
+        return self.stack.pop()
+
+    def _set_af(self, value):
+        self.a = self.f = int32(value)
+
+    @staticmethod
+    def _div(a, b):
+        if b == 0:
+            raise PigsError('division by zero')
+        q = abs(a) // abs(b)
+        return q if (a < 0) == (b < 0) else -q
+
+    @staticmethod
+    def _shift_count(x):
+        return x & 0xff                     ## ARM register shift: bottom byte of the shift count
+
+    ## core instructions, each returns the next pc (None: halt)
+
+    def _exec_HALT(self, pc):
+        return None
+
+    def _exec_NOP(self, pc):
+        return pc + 1
+
+    def _exec_LDA(self, pc, x):
+        self.a = self._value(x)
+        return pc + 1
+
+    def _exec_STA(self, pc, y):
+        self._store(y, self.a)
+        return pc + 1
+
+    def _exec_LD(self, pc, y, x):
+        self._store(y, self._value(x))
+        return pc + 1
+
+    def _exec_X(self, pc, y1, y2):
+        value1, value2 = self._value(y1), self._value(y2)
+        self._store(y1, value2)
+        self._store(y2, value1)
+        return pc + 1
+
+    def _exec_XA(self, pc, y):
+        value = self._value(y)
+        self._store(y, self.a)
+        self.a = value
+        return pc + 1
+
+    def _exec_ADD(self, pc, x):
+        self._set_af(self.a + self._value(x))
+        return pc + 1
+
+    def _exec_SUB(self, pc, x):
+        self._set_af(self.a - self._value(x))
+        return pc + 1
+
+    def _exec_MLT(self, pc, x):
+        self._set_af(self.a * self._value(x))
+        return pc + 1
+
+    def _exec_DIV(self, pc, x):
+        self._set_af(self._div(self.a, self._value(x)))
+        return pc + 1
+
+    def _exec_MOD(self, pc, x):
+        b = self._value(x)
+        self._set_af(self.a - self._div(self.a, b) * b)
+        return pc + 1
+
+    def _exec_AND(self, pc, x):
+        self._set_af(self.a & self._value(x))
+        return pc + 1
+
+    def _exec_OR(self, pc, x):
+        self._set_af(self.a | self._value(x))
+        return pc + 1
+
+    def _exec_XOR(self, pc, x):
+        self._set_af(self.a ^ self._value(x))
+        return pc + 1
+
+    def _exec_RLA(self, pc, x):
+        count = self._shift_count(self._value(x))
+        self._set_af(self.a << count if count < 32 else 0)
+        return pc + 1
+
+    def _exec_RRA(self, pc, x):
+        self._set_af(self.a >> min(self._shift_count(self._value(x)), 31))
+        return pc + 1
+
+    def _exec_CMP(self, pc, x):
+        self.f = int32(self.a - self._value(x))
+        return pc + 1
+
+    def _exec_INR(self, pc, y):
+        self._store(y, self._value(y) + 1)
+        self.f = self._value(y)
+        return pc + 1
+
+    def _exec_DCR(self, pc, y):
+        self._store(y, self._value(y) - 1)
+        self.f = self._value(y)
+        return pc + 1
+
+    def _exec_INRA(self, pc):
+        self._set_af(self.a + 1)
+        return pc + 1
+
+    def _exec_DCRA(self, pc):
+        self._set_af(self.a - 1)
+        return pc + 1
+
+    def _exec_PUSH(self, pc, y):
+        self._push(self._value(y))
+        return pc + 1
+
+    def _exec_PUSHA(self, pc):
+        self._push(self.a)
+        return pc + 1
+
+    def _exec_POP(self, pc, y):
+        self._store(y, self._pop())
+        return pc + 1
+
+    def _exec_POPA(self, pc):
+        self.a = self._pop()
+        return pc + 1
+
+    def _exec_JMP(self, pc, label):
+        return self.program.tags[label]
+
+    def _exec_JZ(self, pc, label):
+        return self.program.tags[label] if self.f == 0 else pc + 1
+
+    def _exec_JNZ(self, pc, label):
+        return self.program.tags[label] if self.f != 0 else pc + 1
+
+    def _exec_JP(self, pc, label):
+        return self.program.tags[label] if self.f >= 0 else pc + 1
+
+    def _exec_JM(self, pc, label):
+        return self.program.tags[label] if self.f < 0 else pc + 1
+
+    def _exec_CALL(self, pc, label):
+        self._push(pc + 1)
+        return self.program.tags[label]
+
+    def _exec_RET(self, pc):
+        return self._pop()
+
+    ## proposed extended instruction set
+
+    def _exec_LDAF(self, pc, x):
+        self._set_af(self._value(x))
+        return pc + 1
+
+    def _exec_NEG(self, pc):
+        self._set_af(-self.a)
+        return pc + 1
+
+    def _exec_NOT(self, pc):
+        self._set_af(~self.a)
+        return pc + 1
+
+    def _exec_NOTL(self, pc):
+        self._set_af(self.a == 0)
+        return pc + 1
+
+    def _exec_ANDL(self, pc, x):
+        self._set_af(self.a != 0 and self._value(x) != 0)
+        return pc + 1
+
+    def _exec_ORL(self, pc, x):
+        self._set_af(self.a != 0 or self._value(x) != 0)
+        return pc + 1
+
+    def _exec_EQ(self, pc, x):
+        self._set_af(self.a == self._value(x))
+        return pc + 1
+
+    def _exec_NE(self, pc, x):
+        self._set_af(self.a != self._value(x))
+        return pc + 1
+
+    def _exec_GT(self, pc, x):
+        self._set_af(self.a > self._value(x))
+        return pc + 1
+
+    def _exec_GE(self, pc, x):
+        self._set_af(self.a >= self._value(x))
+        return pc + 1
+
+    def _exec_LT(self, pc, x):
+        self._set_af(self.a < self._value(x))
+        return pc + 1
+
+    def _exec_LE(self, pc, x):
+        self._set_af(self.a <= self._value(x))
+        return pc + 1
+
+## ---------------------------------------------------------------------------
+
+class EmulatedScript:
+    def __init__(self, vm):
+        self.vm = vm                        ## PigsVm, the script's VM
+        self.status = PI_SCRIPT_INITING     ## int, PI_SCRIPT_* status
+        self.thread = None                  ## None or threading.Thread, running script
+        self.error = None                   ## None or PigsError, runtime error of the last run
+
+class pi:
+    ## pigpio.pi counterpart executing scripts in PigsVm instances, one PigsHal per emulated Pi
+    def __init__(self, host='localhost', port=8888, hal=None, max_steps=None):
+        self.host = host
+        self.port = port
+        self.connected = True
+        self.hal = hal if hal is not None else PigsHal()    ## PigsHal, hardware shared by all scripts
+        self.max_steps = max_steps          ## None or int, limit of executed instructions per run
+        self.scripts = {}                   ## dict(int sid: EmulatedScript), stored scripts
+        self.event_callbacks = []           ## list(_EventCallback), registered event callbacks
+        self.hal.event_handlers.append(self._trigger_event)
+
+    def store_script(self, script):
+        ## returns int, script ID, raises PigsError for invalid scripts and if no script slot is left
+        if isinstance(script, bytes):
+            script = script.decode('utf-8')
+        program = PigsProgram(script)
+        free_sids = sorted(set(range(VM_MAX_SCRIPTS)) - set(self.scripts))
+        if len(free_sids) == 0:
+            raise PigsError('no more room for scripts')
+        self.scripts[free_sids[0]] = EmulatedScript(PigsVm(program, self.hal, self.max_steps))
+        return free_sids[0]
+
+    def run_script(self, script_id, params=None):
+        script = self._script(script_id)
+        if script.status in (PI_SCRIPT_RUNNING, PI_SCRIPT_WAITING):
+            self._stop(script)
+        script.vm.stop_request.clear()
+        script.status = PI_SCRIPT_RUNNING
+        script.error = None
+        script.thread = threading.Thread(target=self._run, args=(script, params), daemon=True)
+        script.thread.start()
+        return 0
+
+    def script_status(self, script_id):
+        ## returns tuple(int status, tuple(int) params)
+        script = self._script(script_id)
+        return script.status, tuple(script.vm.p)
+
+    def update_script(self, script_id, params=None):
+        ## set p0 ... of the (running) script, others keep their values
+        script = self._script(script_id)
+        for i_param, param in enumerate((params or [])[:VM_MAX_PARAMS]):
+            script.vm.p[i_param] = int32(param)
+        return 0
+
+    def stop_script(self, script_id):
+        self._stop(self._script(script_id))
+        return 0
+
+    def delete_script(self, script_id):
+        self._stop(self._script(script_id))
+        del self.scripts[script_id]
+        return 0
+
+    def script_statistics(self, script_id):
+        ## returns str, executed instructions of the script's last run per instruction and per TAG region
+        return self._script(script_id).vm.format_statistics()
+
+    def event_callback(self, event, func=None):
+        event_cb = _EventCallback(self, event, func)
+        self.event_callbacks.append(event_cb)
+        return event_cb
+
+    def stop(self):
+        for script in self.scripts.values():
+            self._stop(script)
+        self.connected = False
+
+    ## Private functions
+
+    def _script(self, script_id):
+        if script_id not in self.scripts:
+            raise PigsError(f'unknown script id {script_id}')
+        return self.scripts[script_id]
+
+    def _run(self, script, params):
+        try:
+            halted = script.vm.run(params)
+            script.status = PI_SCRIPT_HALTED if halted else PI_SCRIPT_INITING
+        except PigsError as e:
+            script.error = e
+            script.status = PI_SCRIPT_FAILED
+            print(f'pigsvm: script failed: {e}', file=sys.stderr)
+
+    def _stop(self, script):
+        if script.thread is not None:
+            script.vm.stop_request.set()
+            script.thread.join()
+            script.thread = None
+        if script.status != PI_SCRIPT_FAILED:
+            script.status = PI_SCRIPT_HALTED
+
+    def _trigger_event(self, event):
+        tick = self.hal.tick_us & 0xffffffff
+        for event_cb in list(self.event_callbacks):
+            if event_cb.event == event and event_cb.func is not None:
+                event_cb.func(event, tick)
+
+class _EventCallback:
+    def __init__(self, emulated_pi, event, func):
+        self.emulated_pi = emulated_pi
+        self.event = event
+        self.func = func
+
+    def cancel(self):
+        if self in self.emulated_pi.event_callbacks:
+            self.emulated_pi.event_callbacks.remove(self)
+
+## ---------------------------------------------------------------------------
+
+def main():
+    parser = argparse.ArgumentParser(description='pigsvm - PIGS script emulator')
+    parser.add_argument('filename', metavar='FILE', help='assembly language file to execute')
+    parser.add_argument('-p', dest='parameter', help='script input parameter, comma-separated list of int')
+    parser.add_argument('-m', dest='max_steps', metavar='N', type=int, help='abort after N executed instructions')
+    parser.add_argument('-s', dest='statistics', action='store_true',
+        help='print executed instructions per instruction and per TAG to STDERR')
+    args = parser.parse_args()
+
+    try:
+        with open(args.filename, 'r') as f:
+            vm = PigsVm(PigsProgram(f.read()), max_steps=args.max_steps)
+        params = None
+        if args.parameter is not None:
+            params = [int(p, 0) for p in args.parameter.strip('[]').split(',')]
+        vm.run(params)
+    except (OSError, ValueError, PigsError) as e:
+        print(f'{PurePath(args.filename).name}: error: {e}', file=sys.stderr)
+        return 1
+    print(f'[{", ".join(str(p) for p in vm.p)}]')
+    if args.statistics:
+        print(vm.format_statistics(), file=sys.stderr)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
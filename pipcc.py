@@ -4,17 +4,22 @@
 ## Runs pcc and executes asm script on a Raspberry Pi.
 ##
 ## Requirements:
-##   pip install pigpio
+##   pip install pigpio (not required with --emulate, which runs scripts in pigsvm.py)
 ##
 
-import sys, re, argparse, configparser
-from time import time, sleep
+import sys, os, re, argparse, configparser, threading, queue, hashlib, json
+from concurrent.futures import ThreadPoolExecutor
+from time import time
 from pathlib import PurePath, Path
 
-import pigpio
+try:
+    import pigpio
+except ImportError:
+    pigpio = None
 
 sys.path.extend(str(Path(__file__).resolve().parent))
-from pcc import pcc
+from pcc import pcc, pcc_batch, PccResult, PccProfile, AsmProfiler, PROFILE_DUMP_MARK
+import pigsvm
 
 def parse_parameter(p_str):
     if p_str is not None:
@@ -26,106 +31,479 @@ def parse_parameter(p_str):
 def format_parameter(p):
     return f'[{p[0]}, {p[1]}, {p[2]}, {p[3]}, {p[4]}, {p[5]}, {p[6]}, {p[7]}, {p[8]}, {p[9]}]'
 
+class PiScriptCache:
+    ## content-addressed cache of compiled asm code and of the IDs of scripts kept stored on pigpiod
+    ## hosts, persisted in cache_dir (default: $PCC_CACHE_DIR/pipcc, ~/.cache/pcc/pipcc)
+
+    SCRIPTS_FILENAME = 'scripts.json'
+
+    def __init__(self, cache_dir=None):
+        if cache_dir is None:
+            cache_dir = Path(os.environ.get('PCC_CACHE_DIR', Path.home() / '.cache' / 'pcc')) / 'pipcc'
+        self.cache_dir = Path(cache_dir)    ## Path, cache directory
+        self.scripts = {}                   ## dict(str host_key: dict(str asm_hash: int sid)), least recently used first
+        self.in_use = set()                 ## set(tuple(str host_key, int sid)), scripts currently running
+        self.lock = threading.Lock()        ## guards scripts and in_use
+        try:
+            with open(self.cache_dir / self.SCRIPTS_FILENAME, 'r') as f:
+                self.scripts = json.load(f)
+        except (OSError, ValueError):
+            pass
+
+    ## compiled asm code
+
+    def compiled_key(self, filenames, options):
+        ## returns None or str, hash of option dict options, pcc and the contents of all input files
+        key = hashlib.sha256(json.dumps(options, sort_keys=True).encode())
+        pcc_dir = Path(__file__).resolve().parent
+        profile_filenames = [options['use_profile']] if options.get('use_profile') is not None else []
+        try:
+            for filename in [pcc_dir / 'pcc.py', pcc_dir / 'vm_api.h'] + filenames + profile_filenames:
+                with open(filename, 'rb') as f:
+                    key.update(f'{Path(filename).resolve()}\n'.encode())
+                    key.update(hashlib.sha256(f.read()).digest())
+        except OSError:
+            return None                     ## left to pcc to report
+        return key.hexdigest()
+
+    def lookup_compiled(self, key):
+        ## returns None or PccResult, compiled asm code stored for key
+        try:
+            with open(self.cache_dir / f'asm-{key}.json', 'r') as f:
+                entry = json.load(f)
+            return PccResult(entry['var_count'], entry['tag_count'], entry['asm_code'])
+        except (OSError, ValueError, KeyError, TypeError):
+            return None
+
+    def add_compiled(self, key, cc_result):
+        entry = {'var_count': cc_result.var_count, 'tag_count': cc_result.tag_count, 'asm_code': cc_result.asm_code}
+        self._write_file(f'asm-{key}.json', entry)
+
+    def compile(self, filenames, **options):
+        ## returns None or PccResult, pcc(filenames, **options) unless the result is cached
+        key = self.compiled_key(filenames, options)
+        cc_result = self.lookup_compiled(key) if key is not None else None
+        if cc_result is None:
+            cc_result = pcc(filenames, **options)
+            if cc_result is not None and key is not None:
+                self.add_compiled(key, cc_result)
+        return cc_result
+
+    ## stored scripts
+
+    def acquire(self, host_key, asm_code):
+        ## returns None or int, ID of the idle script of asm_code stored on host_key, marked as used
+        asm_hash = hashlib.sha256(asm_code.encode('utf-8')).hexdigest()
+        with self.lock:
+            host_scripts = self.scripts.get(host_key, {})
+            sid = host_scripts.get(asm_hash)
+            if sid is None or (host_key, sid) in self.in_use:
+                return None
+            host_scripts[asm_hash] = host_scripts.pop(asm_hash)     ## most recently used
+            self.in_use.add((host_key, sid))
+            return sid
+
+    def add(self, host_key, asm_code, sid):
+        ## record script sid of asm_code just stored on host_key, marked as used
+        asm_hash = hashlib.sha256(asm_code.encode('utf-8')).hexdigest()
+        with self.lock:
+            host_scripts = self.scripts.setdefault(host_key, {})
+            for stale_hash in [cached_hash for cached_hash, cached_sid in host_scripts.items()
+                    if cached_sid == sid and cached_hash != asm_hash]:
+                del host_scripts[stale_hash]    ## pigpiod reused the ID of a script it lost
+            if asm_hash not in host_scripts:    ## else another copy is running, keep the known one
+                host_scripts[asm_hash] = sid
+            self.in_use.add((host_key, sid))
+            self._save_scripts()
+
+    def release(self, host_key, sid):
+        ## returns True if sid is kept in the cache, False if the caller has to delete it
+        with self.lock:
+            self.in_use.discard((host_key, sid))
+            return sid in self.scripts.get(host_key, {}).values()
+
+    def forget(self, host_key):
+        ## drop all scripts of host_key from the cache after it rejected a cached ID: pigpiod restarted,
+        ## the other IDs are gone as well or will be reused for different scripts
+        with self.lock:
+            self.scripts.pop(host_key, None)
+            self._save_scripts()
+
+    def evict(self, host_key):
+        ## returns None or int, ID of the least recently used idle script of host_key, dropped from the cache
+        with self.lock:
+            host_scripts = self.scripts.get(host_key, {})
+            for asm_hash, sid in host_scripts.items():
+                if (host_key, sid) not in self.in_use:
+                    del host_scripts[asm_hash]
+                    self._save_scripts()
+                    return sid
+        return None
+
+    def clear(self, host_key):
+        ## returns list(int), IDs of all scripts of host_key, dropped from the cache with all compiled asm code
+        with self.lock:
+            sids = list(self.scripts.pop(host_key, {}).values())
+            self._save_scripts()
+        for path in self.cache_dir.glob('asm-*.json'):
+            try:
+                path.unlink()
+            except OSError:
+                pass
+        return sids
+
+    ## private methods
+
+    def _save_scripts(self):
+        self._write_file(self.SCRIPTS_FILENAME, self.scripts)
+
+    def _write_file(self, filename, obj):
+        try:
+            self.cache_dir.mkdir(parents=True, exist_ok=True)
+            tmp_path = self.cache_dir / f'{filename}.{os.getpid()}.{threading.get_ident()}.tmp'
+            with open(tmp_path, 'w') as f:
+                json.dump(obj, f)
+            os.replace(tmp_path, self.cache_dir / filename)
+        except OSError as e:
+            print(f'warning: script cache: {e}', file=sys.stderr)
+
+class PiProfileReader:
+    ## receives the counters a script compiled with pcc(profile=True) dumps before HALT in chunks
+    ## of p0 ... p8, announced by p9 == PROFILE_DUMP_MARK + chunk number, see AsmProfiler
+    def __init__(self, profile_counters):
+        self.profile_counters = profile_counters    ## list(tuple(str filename, int row, str func_name, bool is_entry))
+        self.counts = []                    ## list(int), counter values received so far
+
+    def is_complete(self):
+        return len(self.counts) == len(self.profile_counters)
+
+    def poll(self, pi, asm_sid, params):
+        ## returns True if params (the script status) held the next chunk, acknowledged by clearing p9
+        i_chunk = len(self.counts) // AsmProfiler.CHUNK_SIZE
+        if self.is_complete() or params[9] != PROFILE_DUMP_MARK + i_chunk:
+            return False
+        n_counts = min(AsmProfiler.CHUNK_SIZE, len(self.profile_counters) - len(self.counts))
+        self.counts.extend(params[:n_counts])
+        pi.update_script(asm_sid, list(params[:9]) + [0])
+        return True
+
+    def profile(self):
+        ## returns PccProfile, the counts received
+        profile = PccProfile()
+        for (filename, row, func_name, is_entry), count in zip(self.profile_counters, self.counts):
+            profile.add_block(filename or '', row, func_name, count, is_entry)
+        return profile
+
 class PiPcc:
-    def __init__(self, use_cis, hostname=None, port=8888, do_reduce=True):
+    POLL_MIN_SEC = 0.001                    ## first script status poll interval
+
+    def __init__(self, use_cis, hostname=None, port=8888, do_reduce=True, halt_event=None, poll_max_sec=0.05,
+            script_cache=None, backend=None, print_statistics=False, profile_filename=None, use_profile=None):
         self.use_cis = use_cis
         self.hostname = hostname
         self.port = port
         self.do_reduce = do_reduce
+        self.halt_event = halt_event        ## None or int, VM event the compiled script triggers before HALT
+        self.poll_max_sec = poll_max_sec    ## float, maximum script status poll interval
+        self.script_cache = script_cache    ## None or PiScriptCache, keeps compiled and stored scripts for reuse
+        self.backend = backend if backend is not None else pigpio   ## module pigpio or pigsvm (emulator)
+        self.print_statistics = print_statistics    ## bool, log executed instructions per script (pigsvm only)
+        self.profile_filename = profile_filename    ## None or str, run() counts basic blocks into this profile file
+        self.use_profile = use_profile      ## None or str, profile file guiding the compiler (pcc use_profile)
         self.out_parameter = None
-        self.pi = None
+        self.pis = {}                       ## dict(str hostname: pigpio.pi), connected pigpiod instances
         self.t0 = time()
 
     def run(self, filenames, asm_input=False, in_parameter=None, out_parameter=None, timeout_sec=None):
         self.out_parameter = []
         ## connect pigpiod
-        pi = self.pigpiod_connect()
+        pi = self.pigpiod_connect(self.hostname)
         if pi is None:
             return 1
         ## load or compile asm_code
         asm_code = None
+        profile_reader = None
         if asm_input:
             asm_filename = filenames[0]
             asm_code = self.load_asm_source(asm_filename)
         else:
             asm_filename = PurePath(filenames[-1]).stem + '.s'
-            cc_result = pcc(filenames, use_cis=self.use_cis, do_reduce=self.do_reduce)
+            if self.profile_filename is not None:  ## profile counters are not cached
+                cc_result = pcc(filenames, profile=True, **self.pcc_options())
+                if cc_result is not None:
+                    profile_reader = PiProfileReader(cc_result.profile_counters or [])
+            elif self.script_cache is None:
+                cc_result = pcc(filenames, **self.pcc_options())
+            else:
+                cc_result = self.script_cache.compile(filenames, **self.pcc_options())
             if cc_result is not None:
                 self.log_message(f'{asm_filename}: VM variables used: {cc_result.var_count}/150, tags: {cc_result.tag_count}/50')
                 asm_code = cc_result.asm_code
         if asm_code is None:
             return 1
         ## upload and run asm_code
-        asm_sid = pi.store_script(asm_code.encode('utf-8'))
+        result, self.out_parameter = self.execute(pi, self.hostname, asm_filename, asm_code, in_parameter,
+            out_parameter, timeout_sec, use_halt_event=not asm_input, profile_reader=profile_reader)
+        if result == 0 and profile_reader is not None:
+            if not profile_reader.is_complete():
+                self.log_error(f'*** {asm_filename}: script did not dump its profile counters')
+                return 1
+            try:
+                profile_reader.profile().save(self.profile_filename)
+            except OSError as e:
+                self.log_error(f'*** {asm_filename}: {e}')
+                return 1
+            self.log_message(f'{asm_filename}: profile of {len(profile_reader.counts)} basic blocks written '
+                f'to {self.profile_filename}')
+        return result
+
+    def execute(self, pi, hostname, asm_filename, asm_code, in_parameter=None, out_parameter=None, timeout_sec=None,
+            use_halt_event=True, log=None, profile_reader=None):
+        ## upload, run and delete asm_code on pigpiod pi, log: None (print messages) or list(str), message sink
+        ## profile_reader: None or PiProfileReader, receives the profile counters dumped by the script
+        ## returns tuple(int result, list(int) out_parameter), out_parameter is empty unless the script halted
+        ## with a script cache, asm_code stays stored and a stored copy is run again if available
+        p_out = []
+        host_key = f'{hostname or "localhost"}:{self.port}'
+        try:
+            asm_sid, is_cached = self.store_script(pi, host_key, asm_code)
+        except self.backend.error as e:
+            self.log_error(f'*** {asm_filename}: store_script() failed: {e}', log)
+            return 1, p_out
+        halt_signal = threading.Event()
+        halt_cb = None
         try:
+            if self.halt_event is not None and use_halt_event:
+                halt_cb = pi.event_callback(self.halt_event, lambda event, tick: halt_signal.set())
             t1 = time()
-            run_result = pi.run_script(asm_sid, in_parameter)
+            try:
+                run_result = pi.run_script(asm_sid, in_parameter)
+            except self.backend.error:
+                if not is_cached:
+                    raise
+                ## cached script is gone (e.g. pigpiod restarted), store it again
+                self.script_cache.forget(host_key)
+                self.script_cache.release(host_key, asm_sid)
+                asm_sid, is_cached = self.store_script(pi, host_key, asm_code, use_cached=False)
+                t1 = time()
+                run_result = pi.run_script(asm_sid, in_parameter)
             if run_result != 0:
-                print(f'*** {asm_filename}: run_script() failed with error {run_result}', file=sys.stderr)
-                return 1
-            while True:
-                sleep(0)
-                if pi.script_status(asm_sid)[0] == pigpio.PI_SCRIPT_HALTED:
-                    break
-                elif timeout_sec is not None and time() - t1 > timeout_sec:
-                    self.log_message(f'{asm_filename}: script timed out, stopping...')
-                    break
+                self.log_error(f'*** {asm_filename}: run_script() failed with error {run_result}', log)
+                return 1, p_out
+            halt_status = self.wait_script_halted(pi, asm_sid, halt_signal, t1, timeout_sec, profile_reader)
+            if halt_status is None:
+                self.log_message(f'{asm_filename}: script timed out, stopping...', log)
+            elif halt_status == self.backend.PI_SCRIPT_FAILED:
+                self.log_error(f'*** {asm_filename}: script failed', log)
+                return 1, p_out
             status = pi.stop_script(asm_sid)
-            if status != pigpio.PI_SCRIPT_INITING:
-                self.log_message(f'{asm_filename}: not terminated (status: {status}), stopping...')
+            if status != self.backend.PI_SCRIPT_INITING:
+                self.log_message(f'{asm_filename}: not terminated (status: {status}), stopping...', log)
             else:
                 p = pi.script_status(asm_sid)[1]
-                self.out_parameter = list(p)
+                p_out = list(p)
                 out_parameter_str = format_parameter(p)
                 if out_parameter is not None:
-                    if self.out_parameter != out_parameter:
-                        self.log_message(f'{asm_filename}: error: unexpected output parameter:')
-                        self.log_message(f'    expected: {format_parameter(out_parameter)}')
-                        self.log_message(f'    returned: {out_parameter_str}')
-                        return 1
+                    if p_out != out_parameter:
+                        self.log_message(f'{asm_filename}: error: unexpected output parameter:', log)
+                        self.log_message(f'    expected: {format_parameter(out_parameter)}', log)
+                        self.log_message(f'    returned: {out_parameter_str}', log)
+                        return 1, p_out
                     success_msg = 'passed'
                 else:
                     success_msg = 'ok'
-                self.log_message(f'{asm_filename}: {success_msg}: {out_parameter_str}')
+                self.log_message(f'{asm_filename}: {success_msg}: {out_parameter_str}', log)
+                if self.print_statistics:
+                    for line in pi.script_statistics(asm_sid).splitlines():
+                        self.log_error(f'    {line}', log)
         finally:
-            pi.delete_script(asm_sid)
+            if halt_cb is not None:
+                halt_cb.cancel()
+            if not is_cached or not self.script_cache.release(host_key, asm_sid):
+                pi.delete_script(asm_sid)
+        return 0, p_out
+
+    def store_script(self, pi, host_key, asm_code, use_cached=True):
+        ## returns tuple(int asm_sid, bool is_cached), script asm_code stored on pigpiod pi
+        if self.script_cache is None:
+            return pi.store_script(asm_code.encode('utf-8')), False
+        asm_sid = self.script_cache.acquire(host_key, asm_code) if use_cached else None
+        if asm_sid is not None:
+            return asm_sid, True
+        while asm_sid is None:
+            try:
+                asm_sid = pi.store_script(asm_code.encode('utf-8'))
+            except self.backend.error:
+                ## pigpiod's script slots may be used up by cached scripts, make room
+                evicted_sid = self.script_cache.evict(host_key)
+                if evicted_sid is None:
+                    raise
+                self.delete_cached_script(pi, evicted_sid)
+        self.script_cache.add(host_key, asm_code, asm_sid)
+        return asm_sid, True
+
+    def evict_scripts(self, hostnames=None):
+        ## delete the scripts kept by the script cache on hosts (default: this PiPcc's host), clear the cache
+        for hostname in hostnames if hostnames else [self.hostname]:
+            pi = self.pigpiod_connect(hostname)
+            if pi is None:
+                print(f'*** error: failed to connect pigpiod on "{hostname or "localhost"}"', file=sys.stderr)
+                return 1
+            asm_sids = self.script_cache.clear(f'{hostname or "localhost"}:{self.port}')
+            for asm_sid in asm_sids:
+                self.delete_cached_script(pi, asm_sid)
+            self.log_message(f'{hostname or "localhost"}: {len(asm_sids)} cached script(s) deleted')
         return 0
 
-    def run_testsuite(self, ts_filename):
+    def pcc_options(self):
+        return {'use_cis': self.use_cis, 'do_reduce': self.do_reduce, 'halt_event': self.halt_event,
+            'use_profile': self.use_profile}
+
+    def wait_script_halted(self, pi, asm_sid, halt_signal, t_start, timeout_sec, profile_reader=None):
+        ## returns int PI_SCRIPT_HALTED or PI_SCRIPT_FAILED when script asm_sid has ended, None if
+        ## timeout_sec has passed since t_start
+        ## polls the script status with doubling intervals up to poll_max_sec, setting halt_signal
+        ## (from the HALT event callback) wakes up the poll immediately, as does a chunk of profile counters
+        poll_sec = self.POLL_MIN_SEC
+        while True:
+            status, params = pi.script_status(asm_sid)
+            if status in (self.backend.PI_SCRIPT_HALTED, self.backend.PI_SCRIPT_FAILED):
+                return status
+            if profile_reader is not None and profile_reader.poll(pi, asm_sid, params):
+                poll_sec = self.POLL_MIN_SEC    ## the next chunk follows shortly
+            wait_sec = poll_sec
+            if timeout_sec is not None:
+                remaining_sec = t_start + timeout_sec - time()
+                if remaining_sec <= 0:
+                    return None
+                wait_sec = min(wait_sec, remaining_sec)
+            if halt_signal.wait(wait_sec):
+                halt_signal.clear()
+                poll_sec = self.POLL_MIN_SEC    ## event precedes HALT, status follows shortly
+            else:
+                poll_sec = min(poll_sec * 2, self.poll_max_sec)
+
+    def run_testsuite(self, ts_filename, hostnames=None, concurrency=1):
+        ## compiles all tests up front in parallel, then runs them in concurrency script slots on each
+        ## of the hosts (default: this PiPcc's host), results are reported in test suite order
         config = configparser.ConfigParser()
         config.read(ts_filename)
-        n_sections = len(config.sections())
-        for i_section, section_name in enumerate(config.sections()):
+        tests = []                          ## list(tuple(str c_file, str c_filepath, param_in, param_out, timeout_sec,
+                                            ## dict cc_options, str cc_error))
+        for section_name in config.sections():
             section = config[section_name]
             if 'c_file' not in section:
                 print(f'*** error: missing required parameter "c_file" in section [{section_name}]', file=sys.stderr)
                 return 1
             c_file = section.get('c_file')
-            c_filepath = str(Path(ts_filename).with_name(c_file))
-            param_in = parse_parameter(section.get('param_in', None))
-            param_out = parse_parameter(section.get('param_out', None))
-            timeout_sec = section.getint('timeout_sec', None)
-            self.log_message(f'[{i_section+1}/{n_sections}] {c_file}')
-            if self.run([c_filepath], in_parameter=param_in, out_parameter=param_out, timeout_sec=timeout_sec) != 0:
+            cc_options = {}                 ## pcc batch job options of this test, see PccBatchCompiler.compile_job()
+            if 'opt_level' in section:
+                cc_options['opt_level'] = section.get('opt_level')
+            if 'passes' in section:
+                cc_options['passes'] = [flag.strip() for flag in section.get('passes').split(',') if flag.strip()]
+            if section.getboolean('pass_report', False):
+                cc_options['pass_report'] = True
+            tests.append((c_file, str(Path(ts_filename).with_name(c_file)), parse_parameter(section.get('param_in', None)),
+                parse_parameter(section.get('param_out', None)), section.getint('timeout_sec', None), cc_options,
+                section.get('cc_error', None)))
+        ## connect pigpiod instances, each one provides concurrency script slots
+        slots = queue.Queue()
+        for hostname in hostnames if hostnames else [self.hostname]:
+            pi = self.pigpiod_connect(hostname)
+            if pi is None:
+                print(f'*** error: failed to connect pigpiod on "{hostname or "localhost"}"', file=sys.stderr)
                 return 1
+            for i_slot in range(concurrency):
+                slots.put((hostname, pi))
+        ## compile tests not compiled before
+        cc_results = [None] * len(tests)
+        cc_keys = [None] * len(tests)
+        if self.script_cache is not None:
+            for i_test, test in enumerate(tests):
+                cc_keys[i_test] = self.script_cache.compiled_key([test[1]], dict(self.pcc_options(), **test[5]))
+                cc_result = self.script_cache.lookup_compiled(cc_keys[i_test]) if cc_keys[i_test] else None
+                if cc_result is not None:
+                    cc_results[i_test] = {'ok': True, 'asm_code': cc_result.asm_code,
+                        'var_count': cc_result.var_count, 'tag_count': cc_result.tag_count}
+        jobs = [{'id': i_test, 'files': [test[1]], **test[5]} for i_test, test in enumerate(tests) if cc_results[i_test] is None]
+        for batch_result in pcc_batch(jobs, **self.pcc_options()):
+            i_test = batch_result['id']
+            cc_results[i_test] = batch_result
+            if batch_result['ok'] and cc_keys[i_test] is not None and batch_result['pass_report'] is None:
+                self.script_cache.add_compiled(cc_keys[i_test], PccResult(batch_result['var_count'],
+                    batch_result['tag_count'], batch_result['asm_code']))
+        ## run tests in free script slots
+        def run_test(i_test):
+            c_file, c_filepath, param_in, param_out, timeout_sec, cc_options, cc_error = tests[i_test]
+            log = []
+            asm_filename = PurePath(c_file).stem + '.s'
+            cc_result = cc_results[i_test]
+            if cc_error is not None:        ## the test expects a compile error, there is nothing to run
+                if cc_result['ok'] or cc_error not in cc_result['diagnostics']:
+                    self.log_message(f'{asm_filename}: error: expected compile error "{cc_error}", returned:', log)
+                    self.log_error(cc_result['diagnostics'].rstrip('\n') if not cc_result['ok'] else '    (none)', log)
+                    return 1, log
+                self.log_message(f'{asm_filename}: passed: compile error "{cc_error}"', log)
+                return 0, log
+            if not cc_result['ok']:
+                self.log_error(cc_result['diagnostics'].rstrip('\n'), log)
+                return 1, log
+            self.log_message(f'{asm_filename}: VM variables used: {cc_result["var_count"]}/150, '
+                f'tags: {cc_result["tag_count"]}/50', log)
+            if cc_options.get('pass_report'):
+                if cc_result.get('pass_report') is None:
+                    self.log_message(f'{asm_filename}: error: no optimization pass report', log)
+                    return 1, log
+                for line in cc_result['pass_report'].splitlines():
+                    self.log_error(f'    {line}', log)
+            hostname, pi = slots.get()
+            try:
+                return self.execute(pi, hostname, asm_filename, cc_result['asm_code'], param_in, param_out,
+                    timeout_sec, log=log)[0], log
+            finally:
+                slots.put((hostname, pi))
+        failed_count = 0
+        with ThreadPoolExecutor(slots.qsize()) as executor:
+            for i_test, (result, log) in enumerate(executor.map(run_test, range(len(tests)))):
+                self.log_message(f'[{i_test+1}/{len(tests)}] {tests[i_test][0]}')
+                for message in log:
+                    print(message, file=sys.stderr)
+                failed_count += 0 if result == 0 else 1
+        if failed_count > 0:
+            print(f'*** {failed_count} of {len(tests)} test(s) failed', file=sys.stderr)
+            return 1
         return 0
 
     ## private methods
 
     P_ASM_COMMENT = re.compile(r';.*')
 
-    def log_message(self, message):
-        print(f'{time()-self.t0:-4.3f} {message}', file=sys.stderr)
+    def log_message(self, message, log=None):
+        self.log_error(f'{time()-self.t0:-4.3f} {message}', log)
 
-    def pigpiod_connect(self):
-        if self.pi is None:
-            if self.hostname is None:
-                self.pi = pigpio.pi()
+    def log_error(self, message, log=None):
+        if log is None:
+            print(message, file=sys.stderr)
+        else:
+            log.append(message)
+
+    def pigpiod_connect(self, hostname=None):
+        pi = self.pis.get(hostname)
+        if pi is None:
+            if hostname is None:
+                pi = self.backend.pi()
             else:
-                self.pi = pigpio.pi(self.hostname, self.port)
-            if not self.pi.connected:
+                pi = self.backend.pi(hostname, self.port)
+            if not pi.connected:
                 return None
-        return self.pi
+            self.pis[hostname] = pi
+        return pi
+
+    def delete_cached_script(self, pi, asm_sid):
+        try:
+            pi.delete_script(asm_sid)
+        except self.backend.error:                ## already gone
+            pass
 
     def load_asm_source(self, asm_filename):
         try:
@@ -138,21 +516,59 @@ class PiPcc:
 
 def main():
     parser = argparse.ArgumentParser(description='pipcc - PIGS C compiler and runner')
-    parser.add_argument('filenames', metavar='FILE', nargs='+', help='filenames to parse')
+    parser.add_argument('filenames', metavar='FILE', nargs='*', help='filenames to parse')
     parser.add_argument('-e', dest='use_cis', action='store_false', help='use extended instruction set')
     parser.add_argument('-n', dest='do_reduce', action='store_false', help='do not reduce compiled asm code')
     parser.add_argument('-p', dest='parameter', help='script input parameter, comma-separated list of int')
-    parser.add_argument('-t', dest='timeout', help='script timeout in seconds')
-    parser.add_argument('-i', dest='hostname', metavar='HOSTNAME', help='hostname or IP address of pigpiod')
+    parser.add_argument('-t', dest='timeout', type=float, help='script timeout in seconds')
+    parser.add_argument('-w', dest='poll_max', metavar='SEC', type=float, default=0.05,
+        help='maximum script status poll interval in seconds (default: 0.05)')
+    parser.add_argument('-E', dest='halt_event', metavar='EVENT', type=int, choices=range(32),
+        help='compile scripts to trigger VM event EVENT (0-31) before HALT and wait for it')
+    parser.add_argument('-i', dest='hostnames', metavar='HOSTNAME', action='append',
+        help='hostname or IP address of pigpiod, repeat to distribute the test suite over several hosts')
     parser.add_argument('-o', dest='port', metavar='PORT', default=8888, help='port number of pigpiod (default: 8888)')
     parser.add_argument('-s', dest='testsuite', action='store_true', help='execute testsuite FILE')
+    parser.add_argument('-j', dest='concurrency', metavar='N', type=int, choices=range(1, 33), default=1,
+        help='number of test suite scripts running at the same time per host (1-32, default: 1)')
     parser.add_argument('-a', dest='assembler', action='store_true', help='treat input as assembly language file')
+    parser.add_argument('-k', dest='keep_scripts', action='store_true',
+        help='keep scripts stored on pigpiod and compiled code cached for reuse')
+    parser.add_argument('--evict', dest='evict', action='store_true',
+        help='delete the scripts kept with -k from pigpiod and clear the cache')
+    parser.add_argument('--emulate', dest='emulate', action='store_true',
+        help='execute scripts in the host-side PIGS emulator (pigsvm.py) instead of pigpiod')
+    parser.add_argument('--stats', dest='statistics', action='store_true',
+        help='print executed instructions per instruction and per TAG of each script (requires --emulate)')
+    parser.add_argument('--profile', dest='profile', metavar='FILE',
+        help='count basic block executions of the script and write them to the profile FILE')
+    parser.add_argument('--use-profile', dest='use_profile', metavar='FILE',
+        help='compile guided by the profile FILE (see pcc.py --use-profile)')
     args = parser.parse_args()
+    if len(args.filenames) == 0 and not args.evict:
+        parser.error('the following arguments are required: FILE')
+    if args.hostnames is not None and len(args.hostnames) > 1 and not args.testsuite:
+        parser.error('more than one HOSTNAME requires test suite mode (-s)')
+    if args.emulate and (args.keep_scripts or args.evict):
+        parser.error('emulated scripts cannot be kept (-k, --evict)')
+    if args.statistics and not args.emulate:
+        parser.error('--stats requires --emulate')
+    if args.profile is not None and (args.testsuite or args.assembler or args.evict):
+        parser.error('--profile requires a single C program (no -s, -a or --evict)')
+    if pigpio is None and not args.emulate:
+        parser.error('module pigpio not found (pip install pigpio), use --emulate to run without pigpiod')
 
-    pipcc = PiPcc(args.use_cis, hostname=args.hostname, port=args.port, do_reduce=args.do_reduce)
+    hostname = args.hostnames[0] if args.hostnames else None
+    pipcc = PiPcc(args.use_cis, hostname=hostname, port=args.port, do_reduce=args.do_reduce,
+        halt_event=args.halt_event, poll_max_sec=args.poll_max,
+        script_cache=PiScriptCache() if args.keep_scripts or args.evict else None,
+        backend=pigsvm if args.emulate else pigpio, print_statistics=args.statistics,
+        profile_filename=args.profile, use_profile=args.use_profile)
     try:
-        if args.testsuite:
-            result = pipcc.run_testsuite(args.filenames[0])
+        if args.evict:
+            result = pipcc.evict_scripts(args.hostnames)
+        elif args.testsuite:
+            result = pipcc.run_testsuite(args.filenames[0], hostnames=args.hostnames, concurrency=args.concurrency)
         else:
             result = pipcc.run(
                 args.filenames,
@@ -0,0 +1,64 @@
+// test_calling_convention.c
+// Test arguments passed in A, arguments never read and return values forwarded into variables
+
+int calls;
+
+int clamp_sum(int a, int b, int unused)
+{
+    int s = a + b;
+
+    calls++;
+    if (s > 50) {
+        s = 50;
+    }
+    if (s < 0) {
+        s = 0;
+    }
+    return s;
+}
+
+int weight(int x, int k)
+{
+    int r = x * k;
+
+    calls++;
+    if (r > 1000) {
+        r = 1000;
+    }
+    if (x > 100) {
+        return x;          // reads the first argument again
+    }
+    return r - x;
+}
+
+int diff(int a, int b)
+{
+    int r = a - b;
+
+    calls++;
+    if (b > 100) {
+        r += 3;
+    }
+    if (r < -100) {
+        r = -100;
+    }
+    return r;
+}
+
+void main(void)
+{
+    int i, acc = 0, t, n = 0;
+
+    for (i = 0; i < 4; i++) {
+        t = weight(i + p1, 3);
+        acc = clamp_sum(acc, t, n++);
+        acc += weight(acc - 2, p2);
+        t = clamp_sum(p3, acc, 0);
+        p4 = t;
+    }
+    p0 = acc;
+    p1 = diff(10, diff(5, p1));             // nested call assigning the same arguments
+    p2 = diff(p2 * 2, p3 + 1);              // first argument computed last
+    p3 = weight(150, 2) + n;
+    p5 = calls;
+}
@@ -1,6 +1,8 @@
 // test_comparison_ops.c
 // Test comparison operators
 
+int is_less = p2 < p3;         // initializer only, compiled with a built-in function
+
 int test_comparison_ops1(void)
 {
     if (1 == 1) {
@@ -128,4 +130,5 @@ void main()
 {
     p0 = test_comparison_ops1();
     p1 = test_comparison_ops2();
+    p2 = is_less;
 }
@@ -0,0 +1,138 @@
+// test_conditions.c
+// Test conditions compiled to compare-and-branch with short-circuit evaluation
+
+int calls = 0;
+
+int count(int value)
+{
+    ++calls;
+    return value;
+}
+
+int test_conditions1(int a, int b)
+{
+    if (a > 3 && b <= -2) {
+        return -1;
+    }
+
+    if (!(a < b) || a >= b + 100) {
+        return -2;
+    }
+
+    if (b > a) {
+    }
+    else {
+        return -3;
+    }
+
+    if (a > 0x7fffffff || b > 0x7fffffff) {
+        return -4;
+    }
+
+    if (b <= 0x7fffffff && a <= 0x7fffffff) {
+    }
+    else {
+        return -5;
+    }
+
+    if (a * 2 > b - 7 && b - 7 > a * 2) {
+        return -6;
+    }
+
+    return 1;
+}
+
+int test_conditions2(void)
+{
+    calls = 0;
+    if (count(0) && count(1)) {
+        return -1;
+    }
+    if (calls != 1) {
+        return -2;
+    }
+
+    if (count(1) || count(1)) {
+        if (calls != 2) {
+            return -3;
+        }
+    }
+    else {
+        return -4;
+    }
+
+    int n = 0;
+    while (1) {
+        if (++n == 5) {
+            break;
+        }
+    }
+    if (n != 5) {
+        return -5;
+    }
+
+    do {
+        n--;
+    } while (0);
+    if (n != 4) {
+        return -6;
+    }
+
+    if (0) {
+        return -7;
+    }
+
+    return 2;
+}
+
+int test_int_min(int x)
+{
+    int r = 0, n = 0;
+
+    if (x > 0) {
+        r += 1;
+    }
+    if (x <= 0) {
+        r += 10;
+    }
+    if (0 < x) {
+        r += 100;
+    }
+    if (0 >= x) {
+        r += 1000;
+    }
+    for (int i = 2147483645; i > 0; i++) {  // stops when i wraps to INT_MIN
+        n++;
+    }
+    return r + n * 10000;
+}
+
+int test_extremes(int lo, int hi, int zero)
+{
+    int r = 0;
+
+    if (hi > 5) {               // INT_MAX
+        r += 1;
+    }
+    if (lo < -4) {              // INT_MIN
+        r += 10;
+    }
+    if (lo + 5 > 5) {           // INT_MIN + 5 - 6 overflows
+        r += 100;
+    }
+    if (lo > zero) {            // 0 - INT_MIN overflows
+        r += 1000;
+    }
+    if (hi >= zero) {
+        r += 10000;
+    }
+    return r;
+}
+
+void main(void)
+{
+    p0 = test_conditions1(2, 9);
+    p1 = test_conditions2();
+    p2 = test_int_min(p2);
+    p3 = test_extremes(p3, p4, p5);
+}
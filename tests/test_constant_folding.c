@@ -0,0 +1,96 @@
+// test_constant_folding.c
+// Test compile-time constant folding and propagation
+
+enum {
+    PIN_LED  = 4,
+    PIN_EN   = 17,
+    MASK_LED = 1 << PIN_LED,
+    MASK_EN  = 1 << PIN_EN,
+    MASK_ALL = MASK_LED | MASK_EN,
+    MASK_NEXT
+};
+
+int period_us = 250;
+
+int test_constant_folding1(void)
+{
+    if (MASK_ALL != 0x20010) {
+        return -1;
+    }
+
+    if (MASK_NEXT != 0x20011) {
+        return -2;
+    }
+
+    if ((1 << PIN_LED) + (1 << PIN_EN) != MASK_ALL) {
+        return -3;
+    }
+
+    if (-7 / 2 != -3 || -7 % 2 != -1 || 7 % -2 != 1) {
+        return -4;
+    }
+
+    if (0x7fffffff + 1 != -2147483647 - 1) {
+        return -5;
+    }
+
+    if (0775 != 509 || 0x1f != 31) {
+        return -6;
+    }
+
+    if (!(3 < 4) || (3 >= 4) || (2 && 0) || !(0 || 7) || ~0 != -1) {
+        return -7;
+    }
+
+    return 1;
+}
+
+int test_constant_folding2(void)
+{
+    int mask = MASK_LED | MASK_EN;
+    int period = period_us * 2;
+    int a = 1, i;
+
+    if (mask != MASK_ALL) {
+        return -1;
+    }
+
+    if (period != 500) {
+        return -2;
+    }
+
+    {
+        int a = 2;
+        a++;
+        if (a != 3) {
+            return -3;
+        }
+    }
+
+    if (a != 1) {
+        return -4;
+    }
+
+    int sum = 0;
+    for (i = 0; i < 4; ++i) {
+        int step = 1 << i;
+        sum += step + a;
+    }
+    if (sum != 19) {
+        return -5;
+    }
+
+    int n = 5;
+    asm("inr", n);
+    if (n != 6) {
+        return -6;
+    }
+
+    return 2;
+}
+
+void main(void)
+{
+    p0 = test_constant_folding1();
+    p1 = test_constant_folding2();
+}
@@ -0,0 +1,97 @@
+// test_counting_loops.c
+// Test for and while loops counting a variable up or down by one
+
+int count_down(int n)
+{
+    int sum = 0, i;
+
+    for (i = n; i > 0; i--) {
+        sum += i;
+    }
+    return sum * 10 + i;
+}
+
+int count_up(int n)
+{
+    int pulses = 0, i;
+
+    for (i = 0; i < 8; i++) {
+        if (pulses == n) {
+            break;
+        }
+        pulses++;
+    }
+    return pulses * 10 + i;
+}
+
+int count_up_inclusive(int x)
+{
+    int k = 0;
+
+    for (int i = 3; i <= 9; ++i) {
+        k = k * 2 + x;
+    }
+    return k;
+}
+
+int body_writes_counter(int x)
+{
+    int steps = 0;
+
+    for (int i = 2; i > 0; i--) {
+        i ^= x;                 // may step over the stop value
+        steps++;
+    }
+    return steps;
+}
+
+int g;
+
+void skip_two(void)
+{
+    g -= 2;
+}
+
+int call_writes_counter(int n)
+{
+    int calls = 0;
+
+    for (g = n; g > 0; g--) {
+        skip_two();             // writes the global counter
+        calls++;
+    }
+    return calls * 10 + g;
+}
+
+int pre_decrement(int n)
+{
+    int steps = 0;
+
+    while (--n) {
+        steps += 2;
+    }
+    return steps;
+}
+
+int post_decrement(int n)
+{
+    int steps = 0;
+
+    while (n--) {
+        steps++;
+    }
+    return steps * 10 - n;
+}
+
+void main(void)
+{
+    p0 = count_down(p0);
+    p1 = count_down(p1);
+    p2 = count_up(p2);
+    p3 = count_up(p3);
+    p4 = count_up_inclusive(p4);
+    p5 = pre_decrement(p5);
+    p6 = post_decrement(p6);
+    p7 = body_writes_counter(p7);
+    p8 = call_writes_counter(p8);
+}
@@ -0,0 +1,54 @@
+// test_dead_code.c
+// Test elimination of unreachable code and dead stores
+
+int first_above(int x, int limit)
+{
+    while (1) {
+        if (x > limit) {
+            return x;
+        }
+        x += 3;
+    }
+    while (x > 0) {
+        x--;
+    }
+    return -1;
+}
+
+int count_calls(void)
+{
+    int n;
+
+    n++;
+    return n;
+}
+
+int dead_stores(int x)
+{
+    int a = x * 3;
+    int unused = x + 7;
+
+    a = x + 1;
+    unused = a * 2;
+    return a;
+}
+
+int loop_carried(int n)
+{
+    int sum = 0, last = -1, i;
+
+    for (i = 0; i < n; i++) {
+        last = sum;
+        sum += i;
+    }
+    return last;
+}
+
+void main(void)
+{
+    p0 = first_above(p0, 10);
+    count_calls();
+    p1 = count_calls();
+    p2 = dead_stores(p2);
+    p3 = loop_carried(p3);
+}
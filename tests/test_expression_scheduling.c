@@ -0,0 +1,96 @@
+// test_expression_scheduling.c
+// Test evaluation order and temporaries of nested expressions
+
+int g = 1;
+
+int bump(void)
+{
+    g += 5;
+    return 10;
+}
+
+int nested(int a, int b, int c, int d)
+{
+    return (a * b + c * d) - ((a ^ c) * (b - d)) + a - (b * c);
+}
+
+int non_commutative(int a, int b, int c, int d)
+{
+    return (a * b - c) / (d + 1) - (b << (d + 1)) % (a + c) + ((c - a) >> (d - 1));
+}
+
+int compare(int a, int b, int c, int d)
+{
+    int n = 0;
+
+    if (a + b < c * d) {
+        n += 1;
+    }
+    if (a * b > c + d) {
+        n += 2;
+    }
+    if (a + c <= b * d) {
+        n += 4;
+    }
+    if (b - a >= d * c) {
+        n += 8;
+    }
+    if (a * d == b + 1) {
+        n += 16;
+    }
+    if (a - b != c - d - 7) {
+        n += 32;
+    }
+    return n + ((a + b < c * d) + (a * b > c + d) * 2) * 100;
+}
+
+int zero(int a)
+{
+    return a & 0;
+}
+
+int extremes(int a, int b)
+{
+    int lo = 0, hi;
+    int n = 0;
+
+    lo |= (a ^ b ^ 1) << 31;
+    hi = ~lo;
+    n -= (lo > zero(a));
+    n += (lo >= zero(b)) * 10;
+    n += (hi > zero(a)) * 100;
+    n += (hi >= zero(b)) * 1000;
+    n += (zero(a) < hi) * 10000;
+    n += (zero(b) >= hi) * 100000;
+    return n;
+}
+
+int ordered(void)
+{
+    int x = g + bump();
+    int y = bump() - g;
+
+    return x * 100 + y;
+}
+
+int compound(int a, int b)
+{
+    int s = a;
+
+    s += a * b + 1;
+    s *= b - a;
+    s -= (a + b) * 2;
+    return s;
+}
+
+void main(void)
+{
+    int a = p0, b = p1, c = p2, d = p3;
+
+    p0 = nested(a, b, c, d);
+    p1 = non_commutative(a, b, c, d);
+    p2 = compare(a, b, c, d);
+    p3 = ordered();
+    p4 = compound(a, b);
+    p5 = extremes(a, b);
+}
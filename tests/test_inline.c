@@ -0,0 +1,99 @@
+// test_inline.c
+// Test in-line expansion of user-defined functions
+
+int g = 10;
+
+inline int twice(int x);
+
+int add(int a, int b)
+{
+    return a + b;
+}
+
+inline int twice(int x)
+{
+    return add(x, x);
+}
+
+int bump(int x)
+{
+    g = g + 1;
+    return x + g;
+}
+
+int clamp(int x, int lo, int hi)
+{
+    if (x < lo) {
+        return lo;
+    }
+    if (x > hi) {
+        return hi;
+    }
+    return x;
+}
+
+int test_inline1(void)
+{
+    if (add(2, 3) != 5 || add(g, -4) != 6) {
+        return -1;
+    }
+    if (twice(21) != 42 || twice(g) != 20) {
+        return -2;
+    }
+    if (bump(g) != 21 || g != 11) {
+        return -3;
+    }
+    if (clamp(-5, 0, 9) != 0 || clamp(15, 0, 9) != 9 || clamp(g, 0, 20) != 11) {
+        return -4;
+    }
+    return 1;
+}
+
+int test_inline2(void)
+{
+    int i, sum = 0;
+    for (i = 0; i < 5; i++) {
+        sum = add(sum, clamp(i, 1, 3));
+    }
+    return sum;
+}
+
+int mix(int a, int b)
+{
+    int t = a * b;
+    t = t + a;
+    return t - b;
+}
+
+int step(int x)
+{
+    int y = mix(x, 3);
+    if (y > 100) {
+        y = y - 100;
+    }
+    if (y < 0) {
+        y = -y;
+    }
+    y = y + x;
+    y = y * 2;
+    y = y - x;
+    y = y + 1;
+    return y;
+}
+
+int test_inline3(void)
+{
+    // locals of mix() are expanded into step(), their VM variables must not be shared
+    // with variables of test_inline3() that are live across the calls of step()
+    int a = g + 1, b = g + 2;
+    int s = step(a) + a;
+    s = s + step(b) + b;
+    return s + a * b;
+}
+
+void main(void)
+{
+    p0 = test_inline1();
+    p1 = test_inline2();
+    p2 = test_inline3();
+}
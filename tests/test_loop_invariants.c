@@ -0,0 +1,99 @@
+// test_loop_invariants.c
+// Test hoisting of loop-invariant expressions in front of loops
+
+int scale = 3;
+
+int bit_sum(int pin, int n)
+{
+    int sum = 0, i;
+
+    for (i = 0; i < n; i++) {
+        sum += (1 << pin) | i;
+    }
+    return sum;
+}
+
+int bounded(int base, int offset)
+{
+    int count = 0;
+
+    while (count < base + offset) {
+        count += 2;
+    }
+    return count;
+}
+
+int variant_base(int base, int n)
+{
+    int sum = 0;
+
+    do {
+        sum += base * 2;
+        base++;
+        n--;
+    } while (n > 0);
+    return sum;
+}
+
+void bump_scale(void)
+{
+    scale++;
+}
+
+int global_written(int n)
+{
+    int sum = 0, i;
+
+    for (i = 0; i < n; i++) {
+        sum += scale * 10;
+        bump_scale();
+    }
+    return sum;
+}
+
+int guarded(int x, int d, int n)
+{
+    int sum = 0, i;
+
+    for (i = 0; i < n; i++) {
+        if (d != 0) {
+            sum += x / d;
+        } else {
+            sum += -x;
+        }
+    }
+    return sum;
+}
+
+extern int status_p5;               // VM parameter p5, which the host may update at any time
+
+int poll_parameter(void)
+{
+    int polls = 0, x;
+
+    while ((p5 & 7) != 3) {         // polls p5, written through another name
+        status_p5++;
+        polls++;
+    }
+    while (1) {
+        x = p5 & 12;
+        if (x == 8) {
+            break;
+        }
+        status_p5 += 3;
+        polls++;
+    }
+    return polls;
+}
+
+void main(void)
+{
+    int a = p0, b = p1, c = p2, d = p3;
+
+    p0 = bit_sum(a, b);
+    p1 = bounded(b, c);
+    p2 = variant_base(c, d);
+    p3 = global_written(d);
+    p4 = guarded(c * 20, a - 2, d) + guarded(c * 20, a, b);
+    p6 = poll_parameter();
+}
@@ -0,0 +1,81 @@
+// test_loop_unrolling.c
+// Test unrolling of for loops with constant trip count
+
+int shift_in(int byte)
+{
+    int bits = 0, i;
+
+    for (i = 7; i >= 0; i--) {
+        bits = (bits << 1) | ((byte >> i) & 1);
+    }
+    return bits + i;
+}
+
+int unroll_fully(int x)
+{
+    int sum = 0, i;
+
+#pragma unroll
+    for (i = 0; i < 12; i += 3) {
+        sum += x * i;
+    }
+    return sum + i;
+}
+
+int unroll_by_factor(int x)
+{
+    int sum = 0;
+
+#pragma unroll 4
+    for (int i = 1; i <= 10; i++) {
+        if (i & 1) {
+            sum += x;
+        } else {
+            sum -= i;
+        }
+    }
+    return sum;
+}
+
+int nested_exits(int limit)
+{
+    int count = 0, i, j;
+
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 5; j++) {
+            if (j > limit) {
+                break;
+            }
+            count++;
+        }
+        switch (i) {
+        case 1:
+            count += 10;
+            break;
+        default:
+            count++;
+        }
+    }
+    return count;
+}
+
+int early_exit(int x)
+{
+    int i;
+
+    for (i = 0; i < 6; i++) {
+        if (x == i) {
+            break;
+        }
+    }
+    return i;
+}
+
+void main(void)
+{
+    p0 = shift_in(p0);
+    p1 = unroll_fully(p1);
+    p2 = unroll_by_factor(p2);
+    p3 = nested_exits(p3);
+    p4 = early_exit(p4);
+}
@@ -134,6 +134,19 @@ int test_loop7()
         return -7;
     }
 
+    i = 0;
+    z = 0;
+    do {
+        ++i;
+        if (i >= 3) {
+            continue;
+        }
+        ++z;
+    } while (i < 5);
+    if ((i != 5) || (z != 2)) {
+        return -8;
+    }
+
     return 1;
 }
 
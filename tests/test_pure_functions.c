@@ -0,0 +1,101 @@
+// test_pure_functions.c
+// Test compile-time evaluation of pure functions called with constant arguments
+
+enum { CRC_POLY = 0x8c };
+
+int offset = 100;
+
+int bit(int n)
+{
+    return 1 << n;
+}
+
+int clamp(int x, int lo, int hi)
+{
+    if (x < lo) {
+        return lo;
+    }
+    if (x > hi) {
+        return hi;
+    }
+    return x;
+}
+
+int crc8_step(int crc, int data)
+{
+    int i;
+
+    crc ^= data;
+    for (i = 0; i < 8; i++) {
+        if (crc & 1) {
+            crc = (crc >> 1) ^ CRC_POLY;
+        } else {
+            crc >>= 1;
+        }
+    }
+    return crc;
+}
+
+int factorial(int n)
+{
+    int result = 1;
+
+    while (n > 1) {
+        result *= n--;
+    }
+    return result;
+}
+
+int recursive_sum(int n)
+{
+    if (n <= 0) {
+        return 0;
+    }
+    return recursive_sum(n - 1) + 1;
+}
+
+int weekday_len(int day)
+{
+    switch (day) {
+    case 0:
+    case 6:
+        return 2;
+    default:
+        return 8;
+    }
+}
+
+int counter(int reset)
+{
+    int n;
+
+    if (reset) {
+        n = 0;
+    }
+    n++;
+    return n;
+}
+
+int with_offset(int x)
+{
+    return x + offset;
+}
+
+void noop(int x)
+{
+    x++;
+}
+
+void main(void)
+{
+    int mask = bit(3) | bit(bit(2));
+
+    noop(1);
+    p0 = mask + clamp(-5, 0, 10) + clamp(25, 0, 10);
+    p1 = crc8_step(crc8_step(0, 0x31), 0x32) + crc8_step(p1, 0x31);
+    p2 = factorial(6) + weekday_len(6) + weekday_len(3) + recursive_sum(2);
+    counter(1);
+    p3 = counter(0);
+    offset = p3;
+    p4 = with_offset(5);
+}
@@ -0,0 +1,58 @@
+// test_strength_reduction.c
+// Test strength reduction of multiplication, division and modulo by constants
+
+int scale(int x, int factor)
+{
+    return x * factor + 1;
+}
+
+int test_mul(int x)
+{
+    int y = x;
+
+    if (x * 8 != 56 || 4 * x != 28 || x * 0x40000000 != -0x40000000) {
+        return -1;
+    }
+    if (x * 3 != 21 || x * 6 != 42 || x * 7 != 49 || x * 10 != 70 || -x * 14 != -98) {
+        return -2;
+    }
+    y *= 16;
+    if (y != 112) {
+        return -3;
+    }
+    if (scale(x, 32) != 225 || scale(-x, 2) != -13) {
+        return -4;
+    }
+    return 1;
+}
+
+int test_div_mod(int x)
+{
+    int y = -x;
+
+    if ((x & 0xff) / 4 != 1 || ((x >> 1) & 0xff) % 2 != 1 || (x > 3) / 2 != 0) {
+        return -1;
+    }
+    if (x / 2 != 3 || y / 2 != -3 || y / 4 != -1 || y / 8 != 0) {
+        return -2;
+    }
+    if (x % 4 != 3 || y % 4 != -3 || y % 8 != -7 || y % 2 != -1) {
+        return -3;
+    }
+    y /= 2;
+    if (y != -3) {
+        return -4;
+    }
+    y %= 2;
+    if (y != -1) {
+        return -5;
+    }
+    return 2;
+}
+
+void main(void)
+{
+    int x = p0;
+    p0 = test_mul(x);
+    p1 = test_div_mod(x);
+}
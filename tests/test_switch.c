@@ -0,0 +1,106 @@
+// test_switch.c
+// Test switch statements with dense, sparse and fall-through cases
+
+enum { CMD_NOP, CMD_SET, CMD_ADD, CMD_SUB, CMD_MUL, CMD_NEG, CMD_CLR = 9 };
+
+int execute(int acc, int cmd, int arg)
+{
+    switch (cmd) {
+    case CMD_SET:
+        acc = arg;
+        break;
+    case CMD_ADD:
+        acc += arg;
+        break;
+    case CMD_SUB:
+        acc -= arg;
+        break;
+    case CMD_MUL:
+        acc *= arg;
+        break;
+    case CMD_NEG:
+        acc = -acc;
+        break;
+    case CMD_CLR:
+        acc = 0;
+    case CMD_NOP:
+        break;
+    default:
+        acc = -1000;
+    }
+    return acc;
+}
+
+int sparse(int x)
+{
+    switch (x) {
+    case -100:
+        return 1;
+    case 7:
+        return 2;
+    case 1000:
+        return 3;
+    case 0x10000:
+        return 4;
+    case 42:
+        return 5;
+    default:
+        return 0;
+    }
+}
+
+int extreme(int x)
+{
+    switch (x) {
+    case -1250101013:
+        return 1;
+    case 18:
+        return 2;
+    case 1374258896:
+        return 3;
+    case 1405010153:
+        return 4;
+    case 0x7fffffff:
+        return 5;
+    default:
+        return 0;
+    }
+}
+
+int loop_switch(int n)
+{
+    int i, sum = 0;
+
+    for (i = 0; i < n; i++) {
+        switch (i % 4) {
+        case 0:
+            continue;
+        case 1:
+            sum += 1;
+        case 2:
+            sum += 10;
+            break;
+        default:
+            sum += 100;
+        }
+        sum += 1000;
+    }
+    return sum;
+}
+
+void main(void)
+{
+    int acc = p0;
+
+    acc = execute(acc, CMD_ADD, 3);
+    acc = execute(acc, CMD_MUL, 4);
+    acc = execute(acc, CMD_NEG, 0);
+    p0 = acc;
+    p1 = execute(p1, CMD_CLR, 0) + execute(3, CMD_NOP, 0) + execute(1, 7, 0) + execute(1, CMD_SUB, 2) * 10;
+    p2 = sparse(-100) * 10000 + sparse(0x10000) * 1000 + sparse(42) * 100 + sparse(8) * 10 + sparse(1000);
+    p3 = loop_switch(p3);
+    p4 = extreme(p4);
+    p5 = extreme(p5);
+    p6 = extreme(p6);
+    p7 = extreme(p7);
+}